@@ -0,0 +1,150 @@
+// Host benchmark and golden-frame check for the LedEffects render path.
+// Build and run with: pio run -e native -t exec
+//
+// The runner first replays every effect mode (and a few crossfades) on a
+// virtual clock and compares framebuffer hashes against
+// bench/golden_frames.txt, then times each mode and the dual-render
+// crossfade against the LED_FRAME_DELAY_MS frame budget. It exits 1 when any
+// checkpoint differs or is missing on either side, and 2 without a golden file.
+// After an intentional visual change, re-record the goldens with:
+//   .pio/build/native/program --record
+
+#include <Arduino.h>
+#include <stdio.h>
+#include <chrono>
+#include <map>
+#include <string>
+#include "config.h"
+#include "led_effects.h"
+#include "golden_replay.h"
+
+static const uint32_t kFramesPerRun = 2000;
+static const unsigned long kTickMs = 25; // longer than any animated frame interval
+
+struct BenchResult {
+  uint32_t frames;   // rendered
+  uint32_t shown;    // transmitted
+  double nsPerFrame;
+  double nsWorst;
+};
+
+static bool saveGoldens(const char* path, const std::map<std::string, uint32_t>& hashes) {
+  FILE* f = fopen(path, "w");
+  if (!f) return false;
+  for (const auto& kv : hashes) fprintf(f, "%s %08x\n", kv.first.c_str(), kv.second);
+  fclose(f);
+  return true;
+}
+
+static BenchResult timeService(LedEffects& fx) {
+  const uint32_t renderedBefore = fx.getFramesRendered();
+  const uint32_t shownBefore = fx.strip.showCount();
+  double total = 0.0;
+  double worst = 0.0;
+  for (uint32_t i = 0; i < kFramesPerRun; ++i) {
+    native_shim::advanceMillis(kTickMs);
+    auto t0 = std::chrono::steady_clock::now();
+    fx.service();
+    auto t1 = std::chrono::steady_clock::now();
+    double ns = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count();
+    total += ns;
+    if (ns > worst) worst = ns;
+  }
+
+  BenchResult r;
+  r.frames = fx.getFramesRendered() - renderedBefore;
+  r.shown = fx.strip.showCount() - shownBefore;
+  r.nsPerFrame = total / (double)(r.frames ? r.frames : kFramesPerRun);
+  r.nsWorst = worst;
+  return r;
+}
+
+static BenchResult runMode(uint16_t leds, uint16_t mode) {
+  LedEffects fx(leds, 0, NEO_GRB + NEO_KHZ800);
+  startMode(fx, leds, mode);
+  return timeService(fx);
+}
+
+// The transition is longer than the timed run, so every frame renders both slots.
+static BenchResult runTransition(uint16_t leds, const TransitionCase& tc) {
+  LedEffects fx(leds, 0, NEO_GRB + NEO_KHZ800);
+  startTransition(fx, leds, tc, 60000);
+  return timeService(fx);
+}
+
+static void printMismatch(const LedEffects& names, const char* what, const std::string& checkpoint) {
+  unsigned key = 0, leds = 0, tick = 0;
+  sscanf(checkpoint.c_str(), "%u %u %u", &key, &leds, &tick);
+  printf("%-8s %-20s leds=%u t=%lums\n", what, caseName(names, (uint16_t)key).c_str(), leds, tick * kGoldenTickMs);
+}
+
+int main(int argc, char** argv) {
+  bool record = false;
+  bool timing = true;
+  const char* goldenPath = kDefaultGoldenPath;
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "--record") == 0) record = true;
+    else if (strcmp(argv[i], "--no-bench") == 0) timing = false;
+    else goldenPath = argv[i];
+  }
+
+  LedEffects names(1, 0, NEO_GRB + NEO_KHZ800);
+  std::map<std::string, uint32_t> actual;
+  replayAllGoldens(actual);
+
+  int status = 0;
+  if (record) {
+    if (!saveGoldens(goldenPath, actual)) {
+      fprintf(stderr, "cannot write %s\n", goldenPath);
+      return 2;
+    }
+    printf("recorded %u golden checkpoints to %s\n", (unsigned)actual.size(), goldenPath);
+  } else {
+    std::map<std::string, uint32_t> golden;
+    if (!loadGoldens(goldenPath, golden)) {
+      fprintf(stderr, "no golden frames at %s; run with --record to create them\n", goldenPath);
+      status = 2;
+    } else {
+      int failures = 0;
+      for (const auto& kv : actual) {
+        auto it = golden.find(kv.first);
+        if (it == golden.end() || it->second != kv.second) {
+          printMismatch(names, "MISMATCH", kv.first);
+          failures++;
+        }
+      }
+      // Checkpoints the replay no longer produces (a case or strip length was dropped)
+      for (const auto& kv : golden) {
+        if (actual.find(kv.first) == actual.end()) {
+          printMismatch(names, "MISSING", kv.first);
+          failures++;
+        }
+      }
+      printf("golden frames: %u checkpoints, %d mismatched\n", (unsigned)actual.size(), failures);
+      if (failures) status = 1;
+    }
+  }
+
+  if (timing) {
+    printf("%-20s %6s %8s %8s %12s %12s\n", "mode", "leds", "frames", "shown", "ns/frame", "frames/s");
+    for (uint16_t leds : kStripLengths) {
+      for (uint16_t mode = 0; mode < names.getModeCount(); ++mode) {
+        BenchResult r = runMode(leds, mode);
+        printf("%-20s %6u %8u %8u %12.0f %12.0f\n",
+          names.getModeName(mode), leds, r.frames, r.shown, r.nsPerFrame,
+          r.nsPerFrame > 0.0 ? 1e9 / r.nsPerFrame : 0.0);
+      }
+    }
+
+    const double budgetNs = LED_FRAME_DELAY_MS * 1e6;
+    const uint16_t leds = kStripLengths[sizeof(kStripLengths) / sizeof(kStripLengths[0]) - 1];
+    printf("\ncrossfade at %u leds, budget %u ms/frame\n", leds, (unsigned)LED_FRAME_DELAY_MS);
+    printf("%-36s %12s %12s %8s\n", "transition", "ns/frame", "worst ns", "budget");
+    for (uint16_t t = 0; t < sizeof(kTransitions) / sizeof(kTransitions[0]); ++t) {
+      BenchResult r = runTransition(leds, kTransitions[t]);
+      printf("%-36s %12.0f %12.0f %7.1f%%\n", caseName(names, kTransitionKeyBase + t).c_str(),
+        r.nsPerFrame, r.nsWorst, 100.0 * r.nsWorst / budgetNs);
+    }
+  }
+  return status;
+}
@@ -0,0 +1,144 @@
+// Golden-frame replay shared by the host benchmark (bench_effects.cpp) and the
+// native unit tests (test/test_native_effects). Every case starts from a fixed
+// virtual clock and random seed, so the framebuffer hashes are reproducible.
+
+#pragma once
+#include <Arduino.h>
+#include <stdio.h>
+#include <map>
+#include <string>
+#include "led_effects.h"
+
+const uint16_t kStripLengths[] = {16, 300, 1024};
+
+// Golden replay: a short tick exercises the frame-interval gate as well.
+const unsigned long kGoldenTickMs = 7;
+const uint32_t kGoldenTicks = 1200;
+const uint32_t kGoldenCheckpointEvery = 200;
+const char* const kDefaultGoldenPath = "bench/golden_frames.txt";
+
+// Crossfades replayed for the goldens and timed with both slots rendering.
+struct TransitionCase {
+  uint16_t from;
+  uint16_t to;
+};
+const TransitionCase kTransitions[] = {
+  {FX_MODE_STATIC, FX_MODE_BREATH},
+  {FX_MODE_RAINBOW_CYCLE, FX_MODE_COMET},
+  {FX_MODE_TWINKLE, FX_MODE_FIRE_FLICKER},
+};
+const uint16_t kTransitionMs = 1000;
+const uint16_t kTransitionKeyBase = 1000; // golden keys above the mode ids
+const unsigned long kTransitionLeadMs = 500; // run the outgoing effect first
+const uint16_t kLayeredKey = 2000;           // golden key for the layered-segments case
+
+inline void startMode(LedEffects& fx, uint16_t leds, uint16_t mode) {
+  native_shim::setMillis(0);
+  randomSeed(1);
+  fx.init();
+  fx.setBrightness(128);
+  fx.setGamma(2.2f);
+  fx.setSegment(0, 0, leds, mode, RED, 3000, false);
+  fx.service();
+}
+
+inline void startTransition(LedEffects& fx, uint16_t leds, const TransitionCase& tc, uint16_t ms) {
+  startMode(fx, leds, tc.from);
+  for (unsigned long t = 0; t < kTransitionLeadMs; t += kGoldenTickMs) {
+    native_shim::advanceMillis(kGoldenTickMs);
+    fx.service();
+  }
+  fx.setTransitionMs(ms);
+  fx.setSegment(0, 0, leds, tc.to, BLUE, 2000, false);
+  fx.service();
+}
+
+// Three layers: a rainbow base, an additive scanner over the middle half and a
+// half-opacity static block at the end.
+inline void startLayered(LedEffects& fx, uint16_t leds) {
+  startMode(fx, leds, FX_MODE_RAINBOW_CYCLE);
+  fx.setSegmentBlend(1, SEG_BLEND_ADD);
+  fx.setSegment(1, leds / 4, leds - leds / 4, FX_MODE_SCAN, BLUE, 1500, false);
+  fx.setSegmentBlend(2, SEG_BLEND_ALPHA, 128);
+  fx.setSegment(2, leds - leds / 8, leds, FX_MODE_STATIC, WHITE, 3000, false);
+  fx.service();
+}
+
+inline uint32_t hashFrame(const Adafruit_NeoPixel& strip, uint32_t h) {
+  for (uint16_t i = 0; i < strip.numPixels(); ++i) {
+    uint32_t c = strip.getPixelColor(i);
+    for (uint8_t b = 0; b < 4; ++b) {
+      h ^= (c >> (b * 8)) & 0xFF;
+      h *= 16777619u;
+    }
+  }
+  return h;
+}
+
+inline std::string goldenKey(uint16_t mode, uint16_t leds, uint32_t tick) {
+  char key[48];
+  snprintf(key, sizeof(key), "%u %u %u", mode, leds, tick);
+  return key;
+}
+
+// Records a running hash of every rendered frame at each checkpoint. Rendered
+// rather than transmitted, so skipping identical frames leaves the hashes alone.
+inline void replay(LedEffects& fx, uint16_t key, uint16_t leds, std::map<std::string, uint32_t>& out) {
+  uint32_t h = hashFrame(fx.strip, 2166136261u);
+  uint32_t rendered = fx.getFramesRendered();
+  for (uint32_t tick = 1; tick <= kGoldenTicks; ++tick) {
+    native_shim::advanceMillis(kGoldenTickMs);
+    fx.service();
+    if (fx.getFramesRendered() != rendered) {
+      rendered = fx.getFramesRendered();
+      h = hashFrame(fx.strip, h);
+    }
+    if (tick % kGoldenCheckpointEvery == 0) out[goldenKey(key, leds, tick)] = h;
+  }
+}
+
+inline void replayMode(uint16_t leds, uint16_t mode, std::map<std::string, uint32_t>& out) {
+  LedEffects fx(leds, 0, NEO_GRB + NEO_KHZ800);
+  startMode(fx, leds, mode);
+  replay(fx, mode, leds, out);
+}
+
+inline void replayTransition(uint16_t leds, uint16_t index, std::map<std::string, uint32_t>& out) {
+  LedEffects fx(leds, 0, NEO_GRB + NEO_KHZ800);
+  startTransition(fx, leds, kTransitions[index], kTransitionMs);
+  replay(fx, kTransitionKeyBase + index, leds, out);
+}
+
+inline void replayLayered(uint16_t leds, std::map<std::string, uint32_t>& out) {
+  LedEffects fx(leds, 0, NEO_GRB + NEO_KHZ800);
+  startLayered(fx, leds);
+  replay(fx, kLayeredKey, leds, out);
+}
+
+inline std::string caseName(const LedEffects& names, uint16_t key) {
+  if (key < kTransitionKeyBase) return names.getModeName(key);
+  if (key == kLayeredKey) return "Layered segments";
+  const TransitionCase& tc = kTransitions[key - kTransitionKeyBase];
+  return std::string(names.getModeName(tc.from)) + " > " + names.getModeName(tc.to);
+}
+
+inline bool loadGoldens(const char* path, std::map<std::string, uint32_t>& out) {
+  FILE* f = fopen(path, "r");
+  if (!f) return false;
+  unsigned mode = 0, leds = 0, tick = 0, hash = 0;
+  while (fscanf(f, "%u %u %u %x", &mode, &leds, &tick, &hash) == 4) {
+    out[goldenKey((uint16_t)mode, (uint16_t)leds, tick)] = hash;
+  }
+  fclose(f);
+  return true;
+}
+
+// Every mode, crossfade and the layered case at every strip length
+inline void replayAllGoldens(std::map<std::string, uint32_t>& out) {
+  LedEffects names(1, 0, NEO_GRB + NEO_KHZ800);
+  for (uint16_t leds : kStripLengths) {
+    for (uint16_t mode = 0; mode < names.getModeCount(); ++mode) replayMode(leds, mode, out);
+    for (uint16_t t = 0; t < sizeof(kTransitions) / sizeof(kTransitions[0]); ++t) replayTransition(leds, t, out);
+    replayLayered(leds, out);
+  }
+}
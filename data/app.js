@@ -6,6 +6,7 @@
     current: null,
     effects: null,
     preview: { enabled: false, key: "" },
+    ledStream: { controller: null, active: false, retryAt: 0, lastCurrentAt: 0 },
     initialized: {
       navigation: false,
       topbar: false,
@@ -71,17 +72,29 @@
       tenant: $("cfg-tenant").value || "",
       poll_interval: parseInt($("cfg-poll").value, 10) || 30,
       led_type_rgbw: $("cfg-led-type").value === "true",
-      status_led_enabled: $("cfg-status-led").checked
+      status_led_enabled: $("cfg-status-led").checked,
+      presence_layout: $("cfg-presence-layout").value || "aggregate",
+      presence_users: ($("cfg-presence-users").value || "").split(/\s+/).filter(function (id) {
+        return id.length > 0;
+      })
     };
   }
 
+  function presenceUserIds(settings) {
+    return (settings.presence_users || []).map(function (user) {
+      return user.id;
+    });
+  }
+
   function configHasUnsavedChanges(payload) {
     const current = APP.settings || {};
     return (current.client_id || "") !== (payload.client_id || "") ||
       (current.tenant || "") !== (payload.tenant || "") ||
       (parseInt(current.poll_interval, 10) || 30) !== (payload.poll_interval || 30) ||
       (!!current.led_type_rgbw) !== (!!payload.led_type_rgbw) ||
-      (!!current.status_led_enabled) !== (!!payload.status_led_enabled);
+      (!!current.status_led_enabled) !== (!!payload.status_led_enabled) ||
+      (current.presence_layout || "aggregate") !== payload.presence_layout ||
+      presenceUserIds(current).join("\n") !== payload.presence_users.join("\n");
   }
 
   async function saveConfigPayload(payload) {
@@ -357,6 +370,7 @@
   async function openRoute(route, pushHistory) {
     const nextRoute = route || "home";
     if (APP.route === "effects" && nextRoute !== "effects") {
+      stopLedStream();
       try {
         await restoreLiveStatusFromEffects();
       } catch (err) {
@@ -395,10 +409,95 @@
     return APP.current;
   }
 
+  async function loadNetStats() {
+    return fetchJson("/api/net_stats", { cache: "no-store" });
+  }
+
   async function loadLedFrame() {
     return fetchJson("/api/led_frame", { cache: "no-store" });
   }
 
+  // Binary live frames from /api/led_stream: 12-byte header ("SG", version,
+  // bytes per pixel, seq u32, count u16, reserved u16) then R,G,B[,W] per LED.
+  const LED_STREAM_FPS = 30;
+  const LED_STREAM_HEADER_BYTES = 12;
+  const LED_STREAM_RETRY_MS = 5000;
+
+  function showMirroredFrame(colors) {
+    if (!colors.length) return;
+    const firstNonZero = colors.find(function (value) { return Number(value) !== 0; });
+    renderLiveStrip((firstNonZero != null ? firstNonZero : (APP.current ? APP.current.color : 0)) >>> 0, colors);
+    safeText($("fx-live-caption"), colors.length + " LEDs mirrored from device");
+  }
+
+  // Decode every complete frame in bytes; returns the unconsumed tail.
+  function consumeLedStreamFrames(bytes) {
+    let offset = 0;
+    let latest = null;
+    while (bytes.length - offset >= LED_STREAM_HEADER_BYTES) {
+      if (bytes[offset] !== 0x53 || bytes[offset + 1] !== 0x47 || bytes[offset + 2] !== 1) {
+        throw new Error("Bad LED stream frame");
+      }
+      const bpp = bytes[offset + 3];
+      const count = bytes[offset + 8] | (bytes[offset + 9] << 8);
+      const frameBytes = LED_STREAM_HEADER_BYTES + count * bpp;
+      if (bytes.length - offset < frameBytes) break;
+      latest = { offset: offset + LED_STREAM_HEADER_BYTES, bpp: bpp, count: count };
+      offset += frameBytes;
+    }
+    if (latest) {
+      const colors = new Array(latest.count);
+      for (let i = 0, p = latest.offset; i < latest.count; i += 1, p += latest.bpp) {
+        const white = latest.bpp === 4 ? bytes[p + 3] : 0;
+        colors[i] = ((white << 24) | (bytes[p] << 16) | (bytes[p + 1] << 8) | bytes[p + 2]) >>> 0;
+      }
+      showMirroredFrame(colors);
+    }
+    return offset ? bytes.slice(offset) : bytes;
+  }
+
+  function startLedStream() {
+    const stream = APP.ledStream;
+    if (stream.controller || Date.now() < stream.retryAt) return;
+    if (typeof AbortController === "undefined" || typeof ReadableStream === "undefined") {
+      stream.retryAt = Infinity;
+      return;
+    }
+    const controller = new AbortController();
+    stream.controller = controller;
+    authFetch("/api/led_stream?fps=" + LED_STREAM_FPS, { cache: "no-store", signal: controller.signal }).then(async function (response) {
+      if (!response.ok || !response.body) throw new Error("HTTP " + response.status);
+      const reader = response.body.getReader();
+      let pending = new Uint8Array(0);
+      stream.active = true;
+      for (;;) {
+        const chunk = await reader.read();
+        if (chunk.done) break;
+        const joined = new Uint8Array(pending.length + chunk.value.length);
+        joined.set(pending, 0);
+        joined.set(chunk.value, pending.length);
+        pending = consumeLedStreamFrames(joined);
+      }
+    }).catch(function (err) {
+      if (err.name !== "AbortError") {
+        console.error("LED stream failed, falling back to polling:", err);
+        stream.retryAt = Date.now() + LED_STREAM_RETRY_MS;
+      }
+    }).finally(function () {
+      if (stream.controller === controller) {
+        stream.controller = null;
+        stream.active = false;
+      }
+    });
+  }
+
+  function stopLedStream() {
+    const stream = APP.ledStream;
+    if (stream.controller) stream.controller.abort();
+    stream.controller = null;
+    stream.active = false;
+  }
+
   function modeName(id) {
     const found = (APP.modes || []).find(function (mode) {
       return parseInt(mode.id, 10) === parseInt(id, 10);
@@ -407,7 +506,7 @@
   }
 
   function fillHome(settings, current) {
-    safeText($("home-poll-interval"), settings.poll_interval);
+    safeText($("home-poll-interval"), settings.poll_interval_current || settings.poll_interval);
     safeText($("home-num-leds"), settings.num_leds);
     safeText($("home-rssi"), settings.wifi_rssi);
     safeText($("home-ssid"), settings.wifi_ssid);
@@ -415,6 +514,7 @@
     safeText($("home-device-time"), settings.device_time || "Not synced");
     safeText($("home-heap"), settings.heap);
     safeText($("home-min-heap"), settings.min_heap);
+    safeText($("home-max-block"), settings.heap_max_block);
     safeText($("home-cpu-freq"), settings.cpu_freq != null ? settings.cpu_freq + " MHz" : "");
     safeText($("home-version"), settings.sketch_version);
     safeText($("home-uptime"), formatUptime(settings.uptime_ms));
@@ -449,12 +549,45 @@
     }
   }
 
+  function fillNetStats(stats) {
+    const container = $("home-net-stats");
+    container.textContent = "";
+    const endpoints = (stats && stats.endpoints) || {};
+    Object.keys(endpoints).forEach(function (name) {
+      const e = endpoints[name];
+      const phases = e.phases || {};
+      const avg = function (phase) {
+        return phases[phase] ? phases[phase].avg_ms + " ms" : "-";
+      };
+      const row = document.createElement("div");
+      row.className = "kv";
+      const label = document.createElement("strong");
+      label.textContent = name;
+      const value = document.createElement("span");
+      value.textContent = e.requests + " req, " + e.failures + " failed" +
+        " \u2022 total " + avg("total") + " (max " + (phases.total ? phases.total.max_ms : 0) + " ms)" +
+        " \u2022 connect " + avg("connect_tls") +
+        " \u2022 first byte " + avg("first_byte") +
+        " \u2022 parse " + avg("read_parse") +
+        " \u2022 last HTTP " + ((e.last && e.last.http_status) || "-");
+      row.appendChild(label);
+      row.appendChild(value);
+      container.appendChild(row);
+    });
+    if (!Object.keys(endpoints).length) safeText(container, "No requests yet");
+    safeText($("home-net-summary"), stats
+      ? "TLS handshakes " + stats.https_handshakes + ", reused connections " + stats.https_reused +
+        ", DNS cache hits " + stats.dns_cache_hits + " / misses " + stats.dns_cache_misses
+      : "");
+  }
+
   async function initHome() {
     if (!APP.refreshers.home) {
       APP.refreshers.home = async function () {
         if (!APP.modes.length) await loadModes();
-        const result = await Promise.all([loadSettings(), loadCurrent()]);
+        const result = await Promise.all([loadSettings(), loadCurrent(), loadNetStats().catch(function () { return null; })]);
         fillHome(result[0], result[1]);
+        fillNetStats(result[2]);
       };
     }
     await APP.refreshers.home();
@@ -475,6 +608,8 @@
     $("cfg-poll").value = parseInt(settings.poll_interval, 10) || 30;
     $("cfg-led-type").value = settings.led_type_rgbw ? "true" : "false";
     $("cfg-status-led").checked = !!settings.status_led_enabled;
+    $("cfg-presence-layout").value = settings.presence_layout || "aggregate";
+    $("cfg-presence-users").value = presenceUserIds(settings).join("\n");
   }
 
   async function loadWifiState() {
@@ -726,7 +861,11 @@
             await APP.refreshers.config();
           }
           setMessage("cfg-status", "Starting device login...");
-          const result = await fetchJson("/api/startDevicelogin", { cache: "no-store" });
+          let result = await fetchJson("/api/startDevicelogin", { cache: "no-store" });
+          while (result && result.pending) {
+            await sleep(1000);
+            result = await fetchJson("/api/startDevicelogin", { cache: "no-store" });
+          }
           if (result && result.user_code) showDeviceLoginDialog(result);
           setMessage("cfg-status", "Device login started. Complete the Microsoft sign-in in the dialog.");
         } catch (err) {
@@ -1258,17 +1397,21 @@
     if (!APP.initialized.effectsLoop) {
       APP.initialized.effectsLoop = true;
       setInterval(function () {
-        if (APP.route !== "effects") return;
-        Promise.all([loadCurrent(), loadLedFrame()]).then(function (result) {
+        if (APP.route !== "effects") {
+          stopLedStream();
+          return;
+        }
+        startLedStream();
+        // While frames arrive over the stream only the status needs polling.
+        const streaming = APP.ledStream.active;
+        const now = Date.now();
+        if (streaming && now - APP.ledStream.lastCurrentAt < 1000) return;
+        APP.ledStream.lastCurrentAt = now;
+        Promise.all([loadCurrent(), streaming ? null : loadLedFrame()]).then(function (result) {
           APP.current = result[0];
           renderEffectsCurrent();
           const frame = result[1];
-          const colors = frame && Array.isArray(frame.frame) ? frame.frame : [];
-          if (colors.length) {
-            const firstNonZero = colors.find(function (value) { return Number(value) !== 0; });
-            renderLiveStrip((firstNonZero != null ? firstNonZero : APP.current.color) >>> 0, colors);
-            safeText($("fx-live-caption"), colors.length + " LEDs mirrored from device");
-          }
+          showMirroredFrame(frame && Array.isArray(frame.frame) ? frame.frame : []);
         }).catch(console.error);
       }, 180);
     }
@@ -1308,6 +1451,9 @@
     safeText($("fw-sketch"), (settings.sketch_size || 0) + " used, " + (settings.free_sketch_space || 0) + " free for OTA");
     safeText($("fw-flash"), (settings.flash_chip_size || "") + " @ " + (settings.flash_chip_speed || "") + " Hz");
     safeText($("fw-sdk"), settings.sdk_version || "");
+    safeText($("fw-ui-source"), settings.ui_source === "partition"
+      ? "uibundle partition, " + (settings.ui_bundle_size || 0) + " of " + (settings.ui_bundle_capacity || 0) + " bytes"
+      : "embedded in firmware" + (settings.ui_bundle_capacity ? " (uibundle partition empty)" : ""));
   }
 
   async function initFirmware() {
@@ -1341,6 +1487,12 @@
       handleOtaSubmit(event, "fw-form", "/update", "fw-status", "Firmware upload complete. Rebooting...");
     });
 
+    const uiForm = $("fw-ui-form");
+    ensureHiddenKey(uiForm);
+    uiForm.addEventListener("submit", function (event) {
+      handleOtaSubmit(event, "fw-ui-form", "/update_ui", "fw-ui-status", "Web UI bundle installed. Reloading...");
+    });
+
     $("fw-view-ota-btn").addEventListener("click", async function () {
       $("fw-ota-log").textContent = "(loading...)";
       $("fw-ota-dialog").showModal();
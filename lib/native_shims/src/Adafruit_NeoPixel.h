@@ -0,0 +1,69 @@
+// Host stand-in for Adafruit_NeoPixel. Pixels live in a plain RAM buffer and
+// show() only counts transmissions, which is all the effects engine needs.
+
+#pragma once
+#include <Arduino.h>
+#include <stdlib.h>
+
+typedef uint16_t neoPixelType;
+
+#define NEO_RGB  ((0 << 6) | (0 << 4) | (1 << 2) | (2))
+#define NEO_GRB  ((1 << 6) | (1 << 4) | (0 << 2) | (2))
+#define NEO_RGBW ((3 << 6) | (0 << 4) | (1 << 2) | (2))
+#define NEO_GRBW ((3 << 6) | (1 << 4) | (0 << 2) | (2))
+#define NEO_KHZ800 0x0000
+
+class Adafruit_NeoPixel {
+public:
+  Adafruit_NeoPixel(uint16_t n, int16_t pin = 6, neoPixelType type = NEO_GRB + NEO_KHZ800)
+  : _pin(pin) {
+    updateType(type);
+    updateLength(n);
+  }
+
+  ~Adafruit_NeoPixel() { free(_pixels); }
+
+  void begin() {}
+  void show() { _showCount++; }
+  void clear() { if (_pixels) memset(_pixels, 0, _numLeds * sizeof(uint32_t)); }
+
+  void updateLength(uint16_t n) {
+    free(_pixels);
+    _pixels = (uint32_t*)calloc(n ? n : 1, sizeof(uint32_t));
+    _numLeds = _pixels ? n : 0;
+  }
+
+  void updateType(neoPixelType t) { _isRGBW = ((t >> 6) & 3) != ((t >> 4) & 3); }
+
+  // Brightness scaling is always disabled by the engine (255), so it is not modelled.
+  void setBrightness(uint8_t b) { _brightness = b; }
+  uint8_t getBrightness() const { return _brightness; }
+
+  void setPixelColor(uint16_t n, uint32_t c) {
+    if (n < _numLeds) _pixels[n] = _isRGBW ? c : (c & 0x00FFFFFFu);
+  }
+  void setPixelColor(uint16_t n, uint8_t r, uint8_t g, uint8_t b) { setPixelColor(n, Color(r, g, b)); }
+  void setPixelColor(uint16_t n, uint8_t r, uint8_t g, uint8_t b, uint8_t w) { setPixelColor(n, Color(r, g, b, w)); }
+
+  uint32_t getPixelColor(uint16_t n) const { return (n < _numLeds) ? _pixels[n] : 0; }
+  uint16_t numPixels() const { return _numLeds; }
+  int16_t getPin() const { return _pin; }
+
+  // Host-only: number of show() calls since construction.
+  uint32_t showCount() const { return _showCount; }
+
+  static uint32_t Color(uint8_t r, uint8_t g, uint8_t b) {
+    return ((uint32_t)r << 16) | ((uint32_t)g << 8) | b;
+  }
+  static uint32_t Color(uint8_t r, uint8_t g, uint8_t b, uint8_t w) {
+    return ((uint32_t)w << 24) | ((uint32_t)r << 16) | ((uint32_t)g << 8) | b;
+  }
+
+private:
+  uint32_t* _pixels = nullptr;
+  uint16_t _numLeds = 0;
+  int16_t _pin = -1;
+  bool _isRGBW = false;
+  uint8_t _brightness = 0;
+  uint32_t _showCount = 0;
+};
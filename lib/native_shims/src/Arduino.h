@@ -0,0 +1,59 @@
+// Host stand-in for the subset of Arduino.h used by the effects engine.
+// Time is virtual: millis() only moves when the host code advances it, so
+// renders are reproducible frame for frame.
+
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+
+typedef bool boolean;
+
+using std::min;
+using std::max;
+
+#ifndef constrain
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+#endif
+
+namespace native_shim {
+
+inline unsigned long& clockMs() {
+  static unsigned long ms = 0;
+  return ms;
+}
+
+inline uint32_t& randomState() {
+  static uint32_t state = 0x12345678u;
+  return state;
+}
+
+inline void setMillis(unsigned long ms) { clockMs() = ms; }
+inline void advanceMillis(unsigned long ms) { clockMs() += ms; }
+
+} // namespace native_shim
+
+inline unsigned long millis() { return native_shim::clockMs(); }
+inline void delay(unsigned long ms) { native_shim::advanceMillis(ms); }
+
+inline void randomSeed(unsigned long seed) {
+  native_shim::randomState() = seed ? (uint32_t)seed : 0x12345678u;
+}
+
+// xorshift32: deterministic across hosts so recorded frames stay stable.
+inline long random(long howbig) {
+  if (howbig <= 0) return 0;
+  uint32_t x = native_shim::randomState();
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  native_shim::randomState() = x;
+  return (long)(x % (uint32_t)howbig);
+}
+
+inline long random(long howsmall, long howbig) {
+  if (howsmall >= howbig) return howsmall;
+  return howsmall + random(howbig - howsmall);
+}
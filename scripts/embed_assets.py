@@ -2,6 +2,15 @@ Import("env")
 
 from pathlib import Path
 import gzip
+import hashlib
+import re
+import struct
+import zlib
+
+try:
+    import brotli
+except ImportError:  # only needed with -DEMBED_ASSETS_BROTLI
+    brotli = None
 
 
 PROJECT_DIR = Path(env.subst("$PROJECT_DIR"))
@@ -10,6 +19,7 @@ INCLUDE_DIR = PROJECT_DIR / "include" / "generated"
 SRC_DIR = PROJECT_DIR / "src" / "generated"
 HEADER_PATH = INCLUDE_DIR / "embedded_assets.h"
 SOURCE_PATH = SRC_DIR / "embedded_assets.cpp"
+BUNDLE_PATH = Path(env.subst("$BUILD_DIR")) / "ui_bundle.bin"
 
 TEXT_ASSET_SUFFIXES = {".html", ".css", ".js", ".svg"}
 CONTENT_TYPES = {
@@ -28,6 +38,114 @@ PUBLIC_ASSET_PATHS = {
 }
 
 
+def build_flag(name: str) -> bool:
+    # The same -D flag also reaches the firmware, which adapts serveEmbeddedAsset()
+    flags = env.GetProjectOption("build_flags", "")
+    if isinstance(flags, (list, tuple)):
+        flags = " ".join(flags)
+    return re.search(r"-D\s*" + re.escape(name) + r"(?![A-Za-z0-9_])", str(flags)) is not None
+
+
+# -DEMBED_ASSETS_BROTLI: add Brotli copies next to gzip. Browsers only offer br
+#   over HTTPS, so on this plain-HTTP UI it mostly helps scripted clients.
+# -DEMBED_ASSETS_COMPRESSED_ONLY: drop the uncompressed copy of anything that has
+#   a compressed one; clients that accept neither get gzip anyway.
+# -DEMBED_ASSETS_NO_MINIFY: embed data/ byte for byte (for debugging the UI).
+# -DEMBED_ASSETS_SETUP_ONLY: only embed the Wi-Fi setup page and what it loads;
+#   the full UI comes from ui_bundle.bin in the uibundle partition.
+EMBED_BROTLI = build_flag("EMBED_ASSETS_BROTLI")
+EMBED_COMPRESSED_ONLY = build_flag("EMBED_ASSETS_COMPRESSED_ONLY")
+EMBED_MINIFY = not build_flag("EMBED_ASSETS_NO_MINIFY")
+EMBED_SETUP_ONLY = build_flag("EMBED_ASSETS_SETUP_ONLY")
+SETUP_PAGE_PATH = "/setup.html"
+
+# ui_bundle.bin layout, mirrored by UiBundleHeader/UiBundleEntry in src/ui_bundle.h
+BUNDLE_MAGIC = b"SGUI"
+BUNDLE_VERSION = 1
+BUNDLE_HEADER = struct.Struct("<4sHHII")
+BUNDLE_ENTRY = struct.Struct("<13I")
+
+# Conservative minifiers: they only drop comments and layout whitespace and keep
+# line breaks in scripts, so they cannot change what the code means.
+CSS_STRING_RE = re.compile(r"""("(?:\\.|[^"\\])*"|'(?:\\.|[^'\\])*')""")
+
+
+def minify_css(text: str) -> str:
+    parts = CSS_STRING_RE.split(text)
+    for i in range(0, len(parts), 2):  # odd indexes are string literals
+        chunk = re.sub(r"/\*.*?\*/", "", parts[i], flags=re.S)
+        chunk = re.sub(r"\s+", " ", chunk)
+        chunk = re.sub(r"\s*([{};,>])\s*", r"\1", chunk)
+        chunk = re.sub(r":\s+", ":", chunk)
+        parts[i] = chunk.replace(";}", "}")
+    return "".join(parts).strip()
+
+
+def minify_js(text: str) -> str:
+    # Line-based so automatic semicolon insertion sees the same line breaks
+    lines = []
+    in_block_comment = False
+    for line in text.splitlines():
+        stripped = line.strip()
+        if in_block_comment:
+            if "*/" in stripped:
+                in_block_comment = False
+            continue
+        if stripped.startswith("/*"):
+            in_block_comment = "*/" not in stripped
+            continue
+        if not stripped or stripped.startswith("//"):
+            continue
+        lines.append(stripped)
+    return "\n".join(lines)
+
+
+def minify_html(text: str) -> str:
+    text = re.sub(r"<!--(?!\[).*?-->", "", text, flags=re.S)
+    out = []
+    verbatim = None  # closing tag while inside <pre>/<textarea>
+    for block in re.split(r"(<script\b[^>]*>.*?</script>)", text, flags=re.S | re.I):
+        if block.lower().startswith("<script"):
+            open_end = block.index(">") + 1
+            close_start = block.lower().rindex("</script>")
+            body = minify_js(block[open_end:close_start])
+            out.append(block[:open_end] + (body + "\n" if body else "") + block[close_start:] + "\n")
+            continue
+        for line in block.splitlines():
+            if verbatim:
+                out.append(line + "\n")
+                if verbatim in line.lower():
+                    verbatim = None
+                continue
+            stripped = line.strip()
+            if not stripped:
+                continue
+            # Whitespace containing a newline renders as one space, so keep the newline
+            out.append(stripped + "\n")
+            for tag in ("pre", "textarea"):
+                if f"<{tag}" in stripped.lower() and f"</{tag}>" not in stripped.lower():
+                    verbatim = f"</{tag}>"
+    return "".join(out)
+
+
+MINIFIERS = {
+    ".css": minify_css,
+    ".js": minify_js,
+    ".html": minify_html,
+}
+
+
+def content_hash(data: bytes) -> str:
+    # 64 bits of SHA-256: plenty to tell builds apart, short enough for URLs
+    return hashlib.sha256(data).hexdigest()[:16]
+
+
+def hashed_path(path: str, digest: str) -> str:
+    # /app.js -> /app.<hash>.js; the hash changes whenever the content does
+    stem, dot, suffix = path.rpartition(".")
+    return f"{stem}.{digest}.{suffix}" if dot else f"{path}.{digest}"
+
+
 def to_symbol(path: str) -> str:
     return "".join(ch if ch.isalnum() else "_" for ch in path.strip("/")).upper()
 
@@ -42,26 +160,124 @@ def to_hex_lines(data: bytes, indent: str = "  ", width: int = 12) -> str:
     return ",\n".join(lines)
 
 
+def asset_routes(assets):
+    # (url, asset index, hashed) for every URL an asset answers to
+    for index, asset in enumerate(assets):
+        yield asset["path"], index, False
+        if asset["hashed_path"]:
+            yield asset["hashed_path"], index, True
+
+
+def quoted_etag(asset, kind: str, suffix: str):
+    # Each encoding is its own representation, so it needs its own strong ETag
+    return f'"{asset["etag"]}{suffix}"' if asset[f"{kind}_data"] or kind == "raw" else None
+
+
+def write_ui_bundle(assets, path: Path) -> int:
+    # Index first so the firmware can map it without parsing; strings and data
+    # follow, each addressed by its offset from the start of the file.
+    table_start = BUNDLE_HEADER.size + BUNDLE_ENTRY.size * len(assets)
+    blob = bytearray()
+
+    def put(data: bytes) -> int:
+        if not data:
+            return 0
+        offset = table_start + len(blob)
+        blob.extend(data)
+        return offset
+
+    def put_str(text) -> int:
+        return put(text.encode("utf-8") + b"\0") if text else 0
+
+    entries = []
+    for asset in assets:
+        fields = [
+            put_str(asset["path"]),
+            put_str(asset["content_type"]),
+            put_str(asset["hashed_path"]),
+            put_str(quoted_etag(asset, "raw", "")),
+            put_str(quoted_etag(asset, "gzip", "-gz")),
+            put_str(quoted_etag(asset, "br", "-br")),
+        ]
+        for kind in ("raw", "gzip", "br"):
+            data = asset[f"{kind}_data"]
+            fields.extend([put(data), len(data)])
+        fields.append(1 if asset["public"] else 0)
+        entries.append(BUNDLE_ENTRY.pack(*fields))
+
+    body = b"".join(entries) + bytes(blob)
+    total = BUNDLE_HEADER.size + len(body)
+    header = BUNDLE_HEADER.pack(BUNDLE_MAGIC, BUNDLE_VERSION, len(assets), total, zlib.crc32(body))
+    path.parent.mkdir(parents=True, exist_ok=True)
+    path.write_bytes(header + body)
+    return total
+
+
 def build_embedded_assets(*_args, **_kwargs) -> None:
+    if EMBED_BROTLI and brotli is None:
+        raise RuntimeError("EMBED_ASSETS_BROTLI needs the Python 'brotli' package (pip install brotli in the PlatformIO Python)")
     INCLUDE_DIR.mkdir(parents=True, exist_ok=True)
     SRC_DIR.mkdir(parents=True, exist_ok=True)
 
-    assets = []
+    sources = []
     if DATA_DIR.exists():
         for path in sorted(DATA_DIR.rglob("*")):
             if not path.is_file() or path.suffix == ".gz":
                 continue
-            rel_path = "/" + path.relative_to(DATA_DIR).as_posix()
-            raw_data = path.read_bytes()
-            gzip_data = gzip.compress(raw_data, compresslevel=9, mtime=0) if path.suffix in TEXT_ASSET_SUFFIXES else b""
-            assets.append({
-                "path": rel_path,
-                "symbol": to_symbol(rel_path),
-                "content_type": CONTENT_TYPES.get(path.suffix, "application/octet-stream"),
-                "public": rel_path in PUBLIC_ASSET_PATHS,
-                "raw_data": raw_data,
-                "gzip_data": gzip_data,
-            })
+            data = path.read_bytes()
+            if EMBED_MINIFY and path.suffix in MINIFIERS:
+                data = MINIFIERS[path.suffix](data.decode("utf-8")).encode("utf-8")
+            sources.append(("/" + path.relative_to(DATA_DIR).as_posix(), path.suffix, data))
+
+    # Static assets get content-hashed URLs that can be cached forever. Pages are
+    # rewritten to reference those URLs before their own hash is taken, so a
+    # changed script also changes the hash of every page that loads it.
+    hashed_paths = {}
+    for rel_path, suffix, raw_data in sources:
+        if suffix != ".html":
+            hashed_paths[rel_path] = hashed_path(rel_path, content_hash(raw_data))
+
+    assets = []
+    for rel_path, suffix, raw_data in sources:
+        references = set()
+        if suffix == ".html":
+            text = raw_data.decode("utf-8")
+            for plain, hashed in hashed_paths.items():
+                if f'"{plain}"' in text:
+                    references.add(plain)
+                text = text.replace(f'"{plain}"', f'"{hashed}"')
+            raw_data = text.encode("utf-8")
+        compressible = suffix in TEXT_ASSET_SUFFIXES
+        gzip_data = gzip.compress(raw_data, compresslevel=9, mtime=0) if compressible else b""
+        br_data = brotli.compress(raw_data, quality=11) if compressible and EMBED_BROTLI else b""
+        digest = content_hash(raw_data)
+        assets.append({
+            "path": rel_path,
+            "hashed_path": hashed_paths.get(rel_path),
+            "symbol": to_symbol(rel_path),
+            "content_type": CONTENT_TYPES.get(suffix, "application/octet-stream"),
+            "public": rel_path in PUBLIC_ASSET_PATHS,
+            "raw_data": raw_data,
+            "gzip_data": gzip_data,
+            "br_data": br_data,
+            "etag": digest,
+            "references": references,
+        })
+        if EMBED_COMPRESSED_ONLY and gzip_data:
+            assets[-1]["raw_data"] = b""
+
+    bundle_size = write_ui_bundle(assets, BUNDLE_PATH)
+    print(f"UI bundle: {BUNDLE_PATH} ({bundle_size} B, {len(assets)} files)")
+
+    if EMBED_SETUP_ONLY:
+        setup_refs = next((a["references"] for a in assets if a["path"] == SETUP_PAGE_PATH), set())
+        assets = [a for a in assets if a["path"] == SETUP_PAGE_PATH or a["path"] in setup_refs]
+
+    raw_total = sum(len(a["raw_data"]) for a in assets)
+    gzip_total = sum(len(a["gzip_data"]) for a in assets)
+    br_total = sum(len(a["br_data"]) for a in assets)
+    print(f"Embedded assets: {len(assets)} files, raw {raw_total} B, gzip {gzip_total} B, br {br_total} B"
+          f"{' (minified)' if EMBED_MINIFY else ''}")
 
     header = """#pragma once
 
@@ -77,10 +293,26 @@ struct EmbeddedAsset {
   const uint8_t* gzipData;
   size_t gzipLength;
   bool publicAsset;
+  const char* hashedPath;  // immutable, content-hashed URL; nullptr for pages
+  const char* etag;        // strong validator for rawData, quoted
+  const char* gzipEtag;    // strong validator for gzipData, quoted; nullptr without gzip
+  const uint8_t* brData;   // Brotli copy; nullptr unless built with EMBED_ASSETS_BROTLI
+  size_t brLength;
+  const char* brEtag;
+};
+
+// One entry per servable URL (plain and content-hashed), sorted by strcmp()
+// so a request path can be found with a binary search
+struct EmbeddedAssetRoute {
+  const char* path;
+  uint16_t asset;          // index into the asset table
+  bool hashed;             // path is the asset's hashedPath
 };
 
 extern const EmbeddedAsset kEmbeddedAssets[];
 extern const size_t kEmbeddedAssetCount;
+extern const EmbeddedAssetRoute kEmbeddedAssetRoutes[];
+extern const size_t kEmbeddedAssetRouteCount;
 """
 
     source_lines = [
@@ -89,36 +321,45 @@ extern const size_t kEmbeddedAssetCount;
     ]
 
     for asset in assets:
-        source_lines.extend([
-            f'static const uint8_t ASSET_RAW_{asset["symbol"]}[] PROGMEM = {{',
-            to_hex_lines(asset["raw_data"]),
-            "};",
-            "",
-        ])
-        if asset["gzip_data"]:
-            source_lines.extend([
-                f'static const uint8_t ASSET_GZIP_{asset["symbol"]}[] PROGMEM = {{',
-                to_hex_lines(asset["gzip_data"]),
-                "};",
-                "",
-            ])
+        for kind in ("raw", "gzip", "br"):
+            if asset[f"{kind}_data"]:
+                source_lines.extend([
+                    f'static const uint8_t ASSET_{kind.upper()}_{asset["symbol"]}[] PROGMEM = {{',
+                    to_hex_lines(asset[f"{kind}_data"]),
+                    "};",
+                    "",
+                ])
+
+    def data_ref(asset, kind):
+        if not asset[f"{kind}_data"]:
+            return "nullptr", "0"
+        return f'ASSET_{kind.upper()}_{asset["symbol"]}', str(len(asset[f"{kind}_data"]))
+
+    def etag_ref(asset, kind, suffix):
+        etag = quoted_etag(asset, kind, suffix)
+        return '"' + etag.replace('"', '\\"') + '"' if etag else "nullptr"
 
     source_lines.append("const EmbeddedAsset kEmbeddedAssets[] = {")
     for asset in assets:
-        gzip_ref = f'ASSET_GZIP_{asset["symbol"]}'
-        gzip_len = str(len(asset["gzip_data"]))
-        if not asset["gzip_data"]:
-            gzip_ref = "nullptr"
-            gzip_len = "0"
+        raw_ref, raw_len = data_ref(asset, "raw")
+        gzip_ref, gzip_len = data_ref(asset, "gzip")
+        br_ref, br_len = data_ref(asset, "br")
+        hashed_ref = f'"{asset["hashed_path"]}"' if asset["hashed_path"] else "nullptr"
         source_lines.append(
-            '  {{ "{path}", "{content_type}", ASSET_RAW_{symbol}, {raw_len}, {gzip_ref}, {gzip_len}, {public_asset} }},'.format(
+            '  {{ "{path}", "{content_type}", {raw_ref}, {raw_len}, {gzip_ref}, {gzip_len}, {public_asset}, {hashed_ref}, {etag}, {gzip_etag}, {br_ref}, {br_len}, {br_etag} }},'.format(
                 path=asset["path"],
                 content_type=asset["content_type"],
-                symbol=asset["symbol"],
-                raw_len=len(asset["raw_data"]),
+                raw_ref=raw_ref,
+                raw_len=raw_len,
                 gzip_ref=gzip_ref,
                 gzip_len=gzip_len,
                 public_asset="true" if asset["public"] else "false",
+                hashed_ref=hashed_ref,
+                etag=etag_ref(asset, "raw", ""),
+                gzip_etag=etag_ref(asset, "gzip", "-gz"),
+                br_ref=br_ref,
+                br_len=br_len,
+                br_etag=etag_ref(asset, "br", "-br"),
             )
         )
     source_lines.extend([
@@ -128,6 +369,17 @@ extern const size_t kEmbeddedAssetCount;
         "",
     ])
 
+    routes = sorted(asset_routes(assets), key=lambda route: route[0].encode("utf-8"))
+    source_lines.append("const EmbeddedAssetRoute kEmbeddedAssetRoutes[] = {")
+    for path, index, hashed in routes:
+        source_lines.append(f'  {{ "{path}", {index}, {"true" if hashed else "false"} }},')
+    source_lines.extend([
+        "};",
+        "",
+        f"const size_t kEmbeddedAssetRouteCount = {len(routes)};",
+        "",
+    ])
+
     HEADER_PATH.write_text(header, encoding="utf-8")
     SOURCE_PATH.write_text("\n".join(source_lines), encoding="utf-8")
 
@@ -0,0 +1,200 @@
+#!/usr/bin/env python3
+"""Local stand-in for the Microsoft login and Graph presence endpoints.
+
+Lets the firmware's device login, token refresh, /me/presence and batched
+getPresencesByUserId paths run without a tenant. Presence for every user
+rotates through ACTIVITIES; POST /mock/presence pins a user to a fixed state.
+
+The firmware always speaks TLS, so serve HTTPS with a throwaway certificate:
+
+    openssl req -x509 -newkey rsa:2048 -nodes -days 30 -subj "/CN=mock-graph" \
+        -keyout mock.key -out mock.crt
+    python3 scripts/mock_graph.py --cert mock.crt --key mock.key --port 8443
+
+and build with the endpoints redirected (certificate checks disabled):
+
+    build_flags =
+        ${env.build_flags}
+        -DGRAPH_BASE_URL=\\"https://192.168.1.50:8443\\"
+        -DLOGIN_BASE_URL=\\"https://192.168.1.50:8443\\"
+        -DDISABLECERTCHECK
+
+Without --cert the server speaks plain HTTP, which is handy for curl.
+"""
+
+import argparse
+import json
+import ssl
+import threading
+import time
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+from urllib.parse import parse_qs
+
+ACTIVITIES = [
+    ("Available", "Available"),
+    ("Busy", "InACall"),
+    ("Busy", "InAMeeting"),
+    ("DoNotDisturb", "Presenting"),
+    ("Away", "Away"),
+    ("BeRightBack", "BeRightBack"),
+    ("Offline", "OffWork"),
+]
+SELF_ID = "00000000-0000-0000-0000-000000000001"
+
+
+class MockState:
+    def __init__(self, rotate_s, pending_polls, throttle_every, retry_after_s):
+        self.lock = threading.Lock()
+        self.started = time.time()
+        self.rotate_s = rotate_s
+        self.pending_polls = pending_polls
+        self.throttle_every = throttle_every
+        self.retry_after_s = retry_after_s
+        self.pinned = {}
+        self.token_polls = 0
+        self.presence_requests = 0
+        self.token_serial = 0
+
+    def presence_for(self, user_id, index):
+        with self.lock:
+            if user_id.lower() in self.pinned:
+                return self.pinned[user_id.lower()]
+        step = int((time.time() - self.started) // self.rotate_s) + index
+        return ACTIVITIES[step % len(ACTIVITIES)]
+
+    def next_tokens(self):
+        with self.lock:
+            self.token_serial += 1
+            serial = self.token_serial
+        return {
+            "token_type": "Bearer",
+            "expires_in": 3600,
+            "access_token": "mock-access-%d" % serial,
+            "refresh_token": "mock-refresh-%d" % serial,
+            "id_token": "mock-id-%d" % serial,
+        }
+
+    def should_throttle(self):
+        with self.lock:
+            self.presence_requests += 1
+            return self.throttle_every > 0 and self.presence_requests % self.throttle_every == 0
+
+
+class Handler(BaseHTTPRequestHandler):
+    server_version = "MockGraph/1.0"
+    protocol_version = "HTTP/1.1"  # keep-alive, like the real endpoints
+
+    def send_json(self, status, body, headers=None):
+        data = json.dumps(body).encode("utf-8")
+        self.send_response(status)
+        self.send_header("Content-Type", "application/json")
+        self.send_header("Content-Length", str(len(data)))
+        for key, value in (headers or {}).items():
+            self.send_header(key, value)
+        self.end_headers()
+        self.wfile.write(data)
+
+    def read_body(self):
+        length = int(self.headers.get("Content-Length") or 0)
+        return self.rfile.read(length).decode("utf-8") if length else ""
+
+    def authorized(self):
+        if self.headers.get("Authorization", "").startswith("Bearer mock-access-"):
+            return True
+        self.send_json(401, {"error": {"code": "InvalidAuthenticationToken", "message": "Unknown token"}})
+        return False
+
+    def throttled(self):
+        if not self.server.state.should_throttle():
+            return False
+        retry = str(self.server.state.retry_after_s)
+        self.send_json(429, {"error": {"code": "TooManyRequests", "message": "Throttled"}}, {"Retry-After": retry})
+        return True
+
+    def presence_doc(self, user_id, index):
+        availability, activity = self.server.state.presence_for(user_id, index)
+        return {"id": user_id, "availability": availability, "activity": activity}
+
+    def do_GET(self):
+        if self.path == "/v1.0/me/presence":
+            if not self.authorized() or self.throttled():
+                return
+            self.send_json(200, self.presence_doc(SELF_ID, 0))
+            return
+        self.send_json(404, {"error": {"code": "NotFound"}})
+
+    def do_POST(self):
+        body = self.read_body()
+        state = self.server.state
+        if self.path.endswith("/oauth2/v2.0/devicecode"):
+            with state.lock:
+                state.token_polls = 0
+            self.send_json(200, {
+                "device_code": "mock-device-code",
+                "user_code": "MOCK1234",
+                "verification_uri": "https://microsoft.com/devicelogin",
+                "expires_in": 900,
+                "interval": 5,
+                "message": "Mock login: the code is approved after a few polls.",
+            })
+            return
+        if self.path.endswith("/oauth2/v2.0/token"):
+            form = parse_qs(body)
+            grant = (form.get("grant_type") or [""])[0]
+            if grant.endswith("device_code"):
+                with state.lock:
+                    state.token_polls += 1
+                    pending = state.token_polls <= state.pending_polls
+                if pending:
+                    self.send_json(400, {"error": "authorization_pending",
+                                         "error_description": "Waiting for the mock user"})
+                    return
+            self.send_json(200, state.next_tokens())
+            return
+        if self.path == "/v1.0/communications/getPresencesByUserId":
+            if not self.authorized() or self.throttled():
+                return
+            try:
+                ids = json.loads(body or "{}").get("ids", [])
+            except ValueError:
+                self.send_json(400, {"error": {"code": "BadRequest", "message": "Invalid JSON"}})
+                return
+            self.send_json(200, {"value": [self.presence_doc(uid, i) for i, uid in enumerate(ids)]})
+            return
+        if self.path == "/mock/presence":
+            pin = json.loads(body or "{}")
+            with state.lock:
+                if pin.get("activity"):
+                    state.pinned[pin["id"].lower()] = (pin.get("availability", pin["activity"]), pin["activity"])
+                else:
+                    state.pinned.pop(pin.get("id", "").lower(), None)
+            self.send_json(200, {"ok": True})
+            return
+        self.send_json(404, {"error": {"code": "NotFound"}})
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--port", type=int, default=8443)
+    parser.add_argument("--cert", help="PEM certificate; enables HTTPS")
+    parser.add_argument("--key", help="PEM private key for --cert")
+    parser.add_argument("--rotate", type=float, default=45.0, help="seconds between presence changes")
+    parser.add_argument("--pending-polls", type=int, default=2, help="token polls answered authorization_pending")
+    parser.add_argument("--throttle-every", type=int, default=0, help="answer every Nth presence request with 429")
+    parser.add_argument("--retry-after", type=int, default=30, help="Retry-After seconds sent with 429")
+    args = parser.parse_args()
+
+    server = ThreadingHTTPServer(("", args.port), Handler)
+    server.state = MockState(args.rotate, args.pending_polls, args.throttle_every, args.retry_after)
+    scheme = "http"
+    if args.cert:
+        context = ssl.SSLContext(ssl.PROTOCOL_TLS_SERVER)
+        context.load_cert_chain(args.cert, args.key)
+        server.socket = context.wrap_socket(server.socket, server_side=True)
+        scheme = "https"
+    print("Mock Graph listening on %s://0.0.0.0:%d" % (scheme, args.port))
+    server.serve_forever()
+
+
+if __name__ == "__main__":
+    main()
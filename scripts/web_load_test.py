@@ -0,0 +1,116 @@
+#!/usr/bin/env python3
+"""Concurrent load test for the device web server.
+
+Hammers /api/settings and /api/led_frame from several threads at once and
+reports per-endpoint latency percentiles. --idle opens sockets that never send
+a request, the way browsers preconnect, to check they do not stall real clients.
+
+    python3 scripts/web_load_test.py --host 192.168.1.60 --key <admin key> \\
+        --workers 6 --duration 30 --idle 2
+"""
+
+import argparse
+import http.client
+import socket
+import threading
+import time
+
+DEFAULT_PATHS = ["/api/settings", "/api/led_frame"]
+
+
+def percentile(sorted_values, pct):
+    if not sorted_values:
+        return float("nan")
+    index = min(len(sorted_values) - 1, max(0, int(round(pct / 100.0 * len(sorted_values) + 0.5)) - 1))
+    return sorted_values[index]
+
+
+class Results:
+    def __init__(self, paths):
+        self.lock = threading.Lock()
+        self.latencies = {path: [] for path in paths}
+        self.errors = {path: 0 for path in paths}
+
+    def add(self, path, seconds, ok):
+        with self.lock:
+            if ok:
+                self.latencies[path].append(seconds * 1000.0)
+            else:
+                self.errors[path] += 1
+
+
+def worker(args, path, results, stop_at):
+    headers = {"X-StatusGlow-Key": args.key} if args.key else {}
+    while time.time() < stop_at:
+        start = time.perf_counter()
+        ok = False
+        try:
+            conn = http.client.HTTPConnection(args.host, args.port, timeout=args.timeout)
+            conn.request("GET", path, headers=headers)
+            response = conn.getresponse()
+            response.read()
+            ok = response.status == 200
+            conn.close()
+        except (OSError, http.client.HTTPException):
+            pass
+        results.add(path, time.perf_counter() - start, ok)
+
+
+def hold_idle_sockets(args, count, stop_at):
+    sockets = []
+    while time.time() < stop_at:
+        sockets = [s for s in sockets if s.fileno() >= 0]
+        while len(sockets) < count:
+            try:
+                sockets.append(socket.create_connection((args.host, args.port), timeout=args.timeout))
+            except OSError:
+                break
+        time.sleep(1.0)
+        # The device drops idle sockets after WEB_PENDING_TIMEOUT_MS; reopen them
+        for s in list(sockets):
+            try:
+                s.setblocking(False)
+                if s.recv(1) == b"":
+                    s.close()
+            except BlockingIOError:
+                pass
+            except OSError:
+                s.close()
+    for s in sockets:
+        s.close()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--host", required=True)
+    parser.add_argument("--port", type=int, default=80)
+    parser.add_argument("--key", help="admin shared key (X-StatusGlow-Key)")
+    parser.add_argument("--workers", type=int, default=4, help="threads per endpoint")
+    parser.add_argument("--duration", type=float, default=20.0, help="seconds to run")
+    parser.add_argument("--timeout", type=float, default=10.0, help="per-request timeout (s)")
+    parser.add_argument("--idle", type=int, default=0, help="idle sockets to hold open")
+    parser.add_argument("--path", action="append", help="endpoint to load (repeatable)")
+    args = parser.parse_args()
+
+    paths = args.path or DEFAULT_PATHS
+    results = Results(paths)
+    stop_at = time.time() + args.duration
+    threads = [threading.Thread(target=worker, args=(args, path, results, stop_at))
+               for path in paths for _ in range(args.workers)]
+    if args.idle:
+        threads.append(threading.Thread(target=hold_idle_sockets, args=(args, args.idle, stop_at)))
+    for t in threads:
+        t.start()
+    for t in threads:
+        t.join()
+
+    print("%-20s %8s %8s %9s %9s %9s" % ("endpoint", "ok", "errors", "p50 ms", "p99 ms", "max ms"))
+    for path in paths:
+        values = sorted(results.latencies[path])
+        print("%-20s %8d %8d %9.1f %9.1f %9.1f" % (
+            path, len(values), results.errors[path],
+            percentile(values, 50), percentile(values, 99), values[-1] if values else float("nan")))
+
+
+if __name__ == "__main__":
+    main()
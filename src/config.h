@@ -8,8 +8,37 @@
 // Networking and timing
 #define DEFAULT_POLLING_PRESENCE_INTERVAL "30"   // Polling interval (seconds) as string
 #define DEFAULT_ERROR_RETRY_INTERVAL 30          // Retry delay after errors (seconds)
-#define TOKEN_REFRESH_TIMEOUT 60                 // Refresh token this many seconds before expiry
+#define TOKEN_REFRESH_TIMEOUT 60                 // Blocking refresh this many seconds before expiry (fallback)
+#define TOKEN_REFRESH_PCT_MIN 70                 // Background refresh at a random point between these
+#define TOKEN_REFRESH_PCT_MAX 85                 // percentages of the token lifetime
+#define DEVICE_LOGIN_RESULT_TTL_S 15             // Device-code start result kept for the polling client (seconds)
+// Adaptive presence polling: PRESENCE_POLL_MIN_SECONDS for a window after a change,
+// then doubling per unchanged poll up to the configured poll interval (or the idle
+// cap while the user is Offline)
+#define PRESENCE_POLL_MIN_SECONDS 10
+#define PRESENCE_POLL_FAST_WINDOW_S 300
+#define PRESENCE_POLL_IDLE_MAX_SECONDS 600
+#define PRESENCE_MAX_USERS 16                    // team members fetched in one getPresencesByUserId call
+
+// Microsoft endpoints; override with build flags to point at scripts/mock_graph.py
+#ifndef GRAPH_BASE_URL
+#define GRAPH_BASE_URL "https://graph.microsoft.com"
+#endif
+#ifndef LOGIN_BASE_URL
+#define LOGIN_BASE_URL "https://login.microsoftonline.com"
+#endif
 #define WIFI_STA_CONNECT_TIMEOUT_MS 15000        // Wi-Fi STA connect timeout (ms)
+#define TIME_SYNC_WAIT_MS 10000                  // longest an HTTPS request waits for SNTP (ms)
+#define HTTPS_POOL_SIZE 2                        // kept-alive HTTPS connections (one per host)
+#define HTTPS_KEEPALIVE_IDLE_MS 120000           // close pooled connections idle longer than this (ms)
+#define NET_URL_CAPACITY 192                     // longest Microsoft request URL, built inside each network job
+#define NET_PAYLOAD_CAPACITY 3072                // longest request body; refresh tokens alone can pass 1 KB
+// The Arduino resolver does not report record TTLs, so cached addresses live for a fixed time
+#define DNS_CACHE_SIZE 4                         // hostnames kept by the HTTPS resolver cache
+#define DNS_CACHE_TTL_S 300                      // lifetime of a cached address (seconds)
+#define DNS_CACHE_REFRESH_AHEAD_S 30             // re-resolve in the background this long before expiry
+#define DNS_CACHE_STALE_S 3600                   // keep using an expired address while lookups fail
+#define DNS_CACHE_RETRY_S 30                     // background retry delay after a failed lookup
 
 // LED/effects defaults
 #define DEFAULT_FADE_MS 800         // fade time between effects
@@ -17,6 +46,7 @@
 #define DEFAULT_GAMMA 2.2f          // gamma correction factor
 #define DEFAULT_LED_TYPE_RGBW false // Default: RGB (false), RGBW (true)
 #define STARTUP_SEQUENCE_MS 2000    // startup animation length (ms)
+#define LED_MAX_COUNT 1024          // upper bound for the runtime LED count
 
 // Device/AP name
 #define THING_NAME "StatusGlow"
@@ -62,3 +92,23 @@
 #else
 #define LED_FRAME_DELAY_MS 12 // ~83 FPS on other targets by default
 #endif
+#define LED_IDLE_WAKE_MS 1000       // longest render-task sleep when no effect has a deadline
+#define LED_TASK_STACK 4096         // render task stack (bytes); /api/health reports its low-water mark
+
+// Web server connection queue (StatusGlowWebServer in main.cpp)
+#define WEB_PENDING_CLIENTS 4        // accepted sockets waiting for their request to arrive
+#define WEB_PENDING_TIMEOUT_MS 5000  // drop a socket that has not sent a whole request by then
+#define WEB_PEEK_BYTES 1460          // request bytes inspected per socket (one TCP segment)
+#define WEB_RESPONSE_CHUNK 512       // JSON responses are written to the socket in pieces this size
+#define WEB_ROUTE_CAPACITY 72        // exact-path routes in the sorted route table; extras fall back to WebServer
+
+// Live LED mirror stream (/api/led_stream)
+#define LED_STREAM_MAX_CLIENTS 2     // concurrent browser previews
+#define LED_STREAM_DEFAULT_FPS 30
+#define LED_STREAM_MAX_FPS 60
+#define LED_STREAM_KEEPALIVE_MS 2000 // resend the last frame this often when idle
+#define LED_STREAM_STALL_MS 5000     // drop a viewer whose socket has accepted nothing for this long
+
+// Web UI bundle partition (ui_bundle.h). Only used when the partition table has it.
+#define UI_BUNDLE_PARTITION_LABEL "uibundle"
+#define UI_BUNDLE_PARTITION_SUBTYPE 0x40 // custom data subtype, matches partitions/*_uibundle.csv
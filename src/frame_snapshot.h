@@ -0,0 +1,47 @@
+// Lock-free triple buffer for publishing completed LED frames.
+//
+// The render task fills back(), then publish() swaps it with the shared middle
+// slot. A reader calling latest() swaps the middle slot into its own front slot
+// only when a newer frame is waiting, so neither side ever blocks and the
+// reader always sees a whole frame. One writer task and one reader task only.
+
+#pragma once
+#include <Arduino.h>
+#include <atomic>
+#include "config.h"
+
+struct LedFrame {
+  uint32_t seq = 0;        // 0 until the first frame is published
+  uint16_t count = 0;
+  bool rgbw = false;
+  uint32_t pixels[LED_MAX_COUNT];
+};
+
+class FrameSnapshot {
+public:
+  // Writer side: the buffer being filled for the next publish().
+  LedFrame& back() { return _frames[_back]; }
+
+  void publish() {
+    _frames[_back].seq = ++_seq;
+    _back = _middle.exchange(_back | kFresh) & kIndexMask;
+  }
+
+  // Reader side: newest complete frame. Stays valid until the next latest() call.
+  const LedFrame& latest() {
+    if (_middle.load() & kFresh) {
+      _front = _middle.exchange(_front) & kIndexMask;
+    }
+    return _frames[_front];
+  }
+
+private:
+  static const uint32_t kIndexMask = 0x3;
+  static const uint32_t kFresh = 0x4;
+
+  LedFrame _frames[3];
+  uint32_t _back = 0;
+  std::atomic<uint32_t> _middle{1};
+  uint32_t _front = 2;
+  uint32_t _seq = 0;
+};
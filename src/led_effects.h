@@ -27,6 +27,18 @@ enum EffectMode : uint16_t {
   FX_MODE_FILLER_UP = 18,
 };
 
+// Independent ranges the engine can layer; segment 0 is the full-strip base.
+#ifndef LED_EFFECTS_MAX_SEGMENTS
+#define LED_EFFECTS_MAX_SEGMENTS 4
+#endif
+
+// How a segment combines with the segments below it (lower index = lower layer)
+enum SegmentBlend : uint8_t {
+  SEG_BLEND_REPLACE = 0, // segment pixels overwrite lower layers
+  SEG_BLEND_ADD = 1,     // saturating add, so dark pixels stay transparent
+  SEG_BLEND_ALPHA = 2,   // mix over lower layers by the segment opacity
+};
+
 #ifndef BLACK
 #define BLACK 0x000000
 #endif
@@ -60,17 +72,24 @@ public:
   LedEffects(uint16_t count, uint8_t pin, neoPixelType type)
   : strip(count, pin, type) {
     _count = count;
+    rebuildGammaLut();
+    allocSegment(_segs[0]);
   }
 
   ~LedEffects() {
     if (_aux) { delete [] _aux; _aux = nullptr; }
+    for (auto& seg : _segs) {
+      for (auto& slot : seg.slots) { delete [] slot.fb; slot.fb = nullptr; }
+      delete [] seg.outCov; seg.outCov = nullptr;
+    }
   }
 
   void init() {
     strip.begin();
     strip.setBrightness(255);
     strip.clear();
-    strip.show();
+    show();
+    invalidateFrame();
   }
 
   void start() { /* no-op for NeoPixel */ }
@@ -80,9 +99,19 @@ public:
     strip.updateLength(n);
     strip.setBrightness(255);
     strip.clear();
-    strip.show();
-    _needsRefresh = true;
+    show();
+    invalidateFrame();
+    markRefresh();
     resizeAux();
+    resizeFrameBuffers();
+    for (auto& seg : _segs) {
+      for (auto& slot : seg.slots) {
+        if (slot.segEnd > n) slot.segEnd = n;
+        if (slot.segStart > slot.segEnd) slot.segStart = slot.segEnd;
+      }
+      if (seg.pEnd > n) seg.pEnd = n;
+      if (seg.pStart > seg.pEnd) seg.pStart = seg.pEnd;
+    }
   }
 
   void setPixelType(bool isRGBW) {
@@ -91,18 +120,28 @@ public:
     strip.updateType(type);
     strip.setBrightness(255);
     strip.clear();
-    strip.show();
-    _needsRefresh = true;
+    show();
+    invalidateFrame();
+    markRefresh();
   }
 
   bool getPixelTypeRGBW() const { return _isRGBW; }
 
   uint16_t length() const { return _count; }
 
+  // Incremented on every strip.show() issued by the engine; lets callers spot new frames.
+  uint32_t getFrameCount() const { return _frameCount; }
+  // Frames composited, including ones not sent because they matched the strip.
+  uint32_t getFramesRendered() const { return _framesRendered; }
+
+  // Call after drawing on strip directly so the next engine frame is always sent.
+  void invalidateFrame() { _shownValid = false; }
+
   void setBrightness(uint8_t b) {
     if (_bri == b) return;
     _bri = b;
-    _needsRefresh = true;
+    rebuildLevelLut();
+    markRefresh();
   }
   uint8_t getBrightness() const { return _bri; }
 
@@ -111,36 +150,107 @@ public:
     if (gamma > 5.0f) gamma = 5.0f;
     if (fabsf(_gamma - gamma) < 0.001f) return;
     _gamma = gamma;
-    _needsRefresh = true;
+    rebuildGammaLut();
+    markRefresh();
   }
   float getGamma() const { return _gamma; }
 
-  void setSegment(uint8_t /*segment*/, uint16_t start, uint16_t end, uint16_t mode, uint32_t color, uint16_t speed, bool reverse) {
+  // Each segment runs its own effect over [start, end); segments are layered in index order.
+  void setSegment(uint8_t segment, uint16_t start, uint16_t end, uint16_t mode, uint32_t color, uint16_t speed, bool reverse) {
+    if (segment >= LED_EFFECTS_MAX_SEGMENTS) return;
+    Segment& seg = _segs[segment];
+    allocSegment(seg);
     if (end > _count) end = _count;
-    _p_segStart = start; _p_segEnd = end;
-    _p_mode = (EffectMode)mode; _p_color = color; _p_speed = speed; _p_reverse = reverse;
-    _hasPending = true;
+    if (start > end) start = end;
+    seg.pStart = start; seg.pEnd = end;
+    seg.pMode = (EffectMode)mode; seg.pColor = color; seg.pSpeed = speed; seg.pReverse = reverse;
+    seg.pXfadeMs = _xfadeMs;
+    seg.hasPending = true;
   }
 
+  // Whole-strip effect on the base layer, opaque again whatever layout dimmed it
+  void setBaseEffect(uint16_t end, uint16_t mode, uint32_t color, uint16_t speed, bool reverse) {
+    setSegmentBlend(0, SEG_BLEND_REPLACE, 255);
+    setSegment(0, 0, end, mode, color, speed, reverse);
+  }
+
+  void setSegmentBlend(uint8_t segment, SegmentBlend blend, uint8_t opacity = 255) {
+    if (segment >= LED_EFFECTS_MAX_SEGMENTS) return;
+    _segs[segment].blend = blend;
+    _segs[segment].opacity = opacity;
+    _recomposite = true;
+  }
+
+  // Stop a segment; its pixels fall back to the layers below.
+  void clearSegment(uint8_t segment) {
+    if (segment >= LED_EFFECTS_MAX_SEGMENTS) return;
+    Segment& seg = _segs[segment];
+    for (auto& slot : seg.slots) slot.active = false;
+    seg.hasPending = false;
+    seg.xfadeActive = false;
+    _recomposite = true;
+  }
+
+  bool isSegmentActive(uint8_t segment) const {
+    return segment < LED_EFFECTS_MAX_SEGMENTS && (_segs[segment].slots[_segs[segment].cur].active || _segs[segment].hasPending);
+  }
+  uint8_t getSegmentCount() const { return LED_EFFECTS_MAX_SEGMENTS; }
+
   void trigger() { /* compatibility no-op; pending config is applied in service() */ }
 
+  // Crossfade time for the next setSegment() (0 = switch immediately).
+  // The outgoing effect keeps animating in its own buffer while it is blended out.
+  void setTransitionMs(uint16_t ms) { _xfadeMs = ms; }
+  uint16_t getTransitionMs() const { return _xfadeMs; }
+  bool isTransitioning() const {
+    for (const auto& seg : _segs) if (seg.xfadeActive) return true;
+    return false;
+  }
+
+  // Milliseconds until service() has work to do (0 = due now), capped at maxMs.
+  // Static effects have no deadline of their own; they redraw on a pipeline change.
+  uint32_t msUntilNextFrame(uint32_t maxMs) {
+    if (_recomposite) return 0;
+    const unsigned long now = millis();
+    uint32_t wait = maxMs;
+    for (auto& seg : _segs) {
+      if (seg.hasPending || seg.xfadeActive) return 0;
+      EffectSlot& slot = seg.slots[seg.cur];
+      if (!slot.active) continue;
+      if (slot.mode == FX_MODE_STATIC) {
+        if (slot.needsRefresh) return 0;
+        continue;
+      }
+      _fx = &slot;
+      long left = (long)(slot.lastFrameMs + getFrameIntervalMs() - now);
+      if (left <= 0) return 0;
+      if ((uint32_t)left < wait) wait = (uint32_t)left;
+    }
+    return wait;
+  }
+
   void service() {
-    if (_hasPending) {
-      _segStart = _p_segStart; _segEnd = _p_segEnd;
-      _mode = _p_mode; _color = _p_color; _speed = _p_speed; _reverse = _p_reverse;
-      _startedMs = millis(); _lastFrameMs = 0; _pos = 0; _dir = 1; _phase = 0;
-      // Reset per-mode state on (re)apply
-      if (_mode == FX_MODE_FILLER_UP) {
-        _fillerFill = 0;            // number of filled LEDs
-        _fillerDropAccum = 0.0f;     // distance traveled within current region
-        _fillerFilling = true;       // currently filling (true) or un-filling (false)
-        _fillerLastMs = _startedMs;  // seed timing
+    bool dirty = _recomposite;
+    for (auto& seg : _segs) {
+      bool force = false;
+      if (seg.hasPending) {
+        applyPending(seg);
+        force = true;
       }
-      _hasPending = false;
-      renderFrame(true);
-      return;
+      if (seg.xfadeActive && !seg.outFrozen) renderSlot(seg.slots[seg.cur ^ 1], false);
+      if (renderSlot(seg.slots[seg.cur], force)) dirty = true;
+      if (seg.xfadeActive) dirty = true;  // the blend moves on every tick
     }
-    renderFrame(false);
+    if (!dirty) return;
+    _recomposite = false;
+    composite();
+    _framesRendered++;
+    // Skip the wire transfer when the strip already shows this exact frame
+    uint32_t sum = frameChecksum();
+    if (_shownValid && sum == _shownChecksum) return;
+    _shownChecksum = sum;
+    _shownValid = true;
+    show();
   }
 
   uint16_t getModeCount() const { return 19; }
@@ -181,67 +291,321 @@ public:
   Adafruit_NeoPixel strip;
 
 private:
+  // One effect and the framebuffer it renders into. Two exist so a transition
+  // can keep the outgoing effect running while the incoming one fades in.
+  struct EffectSlot {
+    bool active = false;
+    uint16_t segStart = 0, segEnd = 0;
+    EffectMode mode = FX_MODE_STATIC;
+    uint32_t color = WHITE;
+    uint16_t speed = 3000;
+    bool reverse = false;
+    unsigned long startedMs = 0;
+    unsigned long lastFrameMs = 0;
+    int pos = 0; int dir = 1; int phase = 0;
+    uint8_t wipeIndex = 0;
+    uint32_t wipeColor = WHITE;
+    // Filler Up state
+    uint16_t fillerFill = 0;      // current filled height (0..segLen)
+    float fillerDropAccum = 0.0f; // accumulated drop distance within current region (in LEDs)
+    bool fillerFilling = true;    // true when filling, false when un-filling
+    unsigned long fillerLastMs = 0; // last timestamp for drop advancement
+    bool needsRefresh = true;     // static effects redraw only after a pipeline change
+    uint32_t* fb = nullptr;       // strip-format pixels, _count entries; zero outside the range
+  };
+
+  // A layer: the current effect, the outgoing one while a crossfade runs, and
+  // the config queued by setSegment() until the next service().
+  struct Segment {
+    EffectSlot slots[2];
+    uint8_t cur = 0;              // slot of the current (incoming) effect
+    SegmentBlend blend = SEG_BLEND_REPLACE;
+    uint8_t opacity = 255;
+    bool xfadeActive = false;
+    bool outFrozen = false;       // outgoing buffer holds a snapshot; do not render it
+    uint8_t* outCov = nullptr;    // frozen snapshot: nonzero where it owns the pixel
+    unsigned long xfadeStartMs = 0;
+    uint16_t xfadeDurMs = 0;
+    bool hasPending = false;
+    uint16_t pStart = 0, pEnd = 0;
+    EffectMode pMode = FX_MODE_STATIC;
+    uint32_t pColor = WHITE;
+    uint16_t pSpeed = 3000;
+    bool pReverse = false;
+    uint16_t pXfadeMs = 0;
+  };
+
   uint16_t _count = 0;
   uint8_t _bri = 255;
   bool _isRGBW = false;          // Track current LED type (RGB vs RGBW)
-  uint16_t _segStart = 0, _segEnd = 0;
-  EffectMode _mode = FX_MODE_STATIC;
-  uint32_t _color = WHITE;
-  uint16_t _speed = 3000;
-  bool _reverse = false;
-  uint16_t _p_segStart = 0, _p_segEnd = 0;
-  EffectMode _p_mode = FX_MODE_STATIC;
-  uint32_t _p_color = WHITE;
-  uint16_t _p_speed = 3000;
-  bool _p_reverse = false;
-  bool _hasPending = false;
-  bool _needsRefresh = true;
+  Segment _segs[LED_EFFECTS_MAX_SEGMENTS];
+  EffectSlot* _fx = &_segs[0].slots[0]; // slot being rendered by the render* helpers
+  uint16_t _xfadeMs = 0;
+  bool _recomposite = false;     // layer setup changed; composite even if nothing rendered
+  uint32_t _frameCount = 0;
+  uint32_t _framesRendered = 0;
+  uint32_t _shownChecksum = 0;   // FNV-1a of the last transmitted frame
+  bool _shownValid = false;
   float _gamma = 2.2f;
-  unsigned long _startedMs = 0;
-  unsigned long _lastFrameMs = 0;
-  int _pos = 0; int _dir = 1; int _phase = 0;
   uint8_t* _aux = nullptr;
-  uint8_t _wipeIndex = 0;
-  uint32_t _wipeColor = WHITE;
-  // Filler Up state
-  uint16_t _fillerFill = 0;      // current filled height (0..segLen)
-  float _fillerDropAccum = 0.0f; // accumulated drop distance within current region (in LEDs)
-  bool _fillerFilling = true;    // true when filling, false when un-filling
-  unsigned long _fillerLastMs = 0; // last timestamp for drop advancement
+  // Color pipeline lookup tables (Q16 channel multipliers, 65535 == full scale)
+  uint16_t _gammaLut[256];       // gamma curve over the combined level 0..255
+  uint16_t _levelLut[256];       // effect level 0..255 -> multiplier with brightness applied
+
+  void show() {
+    strip.show();
+    _frameCount++;
+  }
 
-  inline uint16_t segLen() const { return (_segEnd > _segStart) ? (_segEnd - _segStart) : 0; }
+  uint32_t frameChecksum() const {
+    uint32_t h = 2166136261u;
+    for (uint16_t i = 0; i < _count; i++) {
+      h ^= strip.getPixelColor(i);
+      h *= 16777619u;
+    }
+    return h;
+  }
+
+  inline void setPx(uint16_t p, uint32_t c) {
+    if (p < _count) _fx->fb[p] = _isRGBW ? c : (c & 0x00FFFFFFu);
+  }
+
+  inline uint16_t segLen() const { return (_fx->segEnd > _fx->segStart) ? (_fx->segEnd - _fx->segStart) : 0; }
 
   void clearSeg() {
-    for (uint16_t i = _segStart; i < _segEnd; i++) strip.setPixelColor(i, 0);
+    for (uint16_t i = _fx->segStart; i < _fx->segEnd; i++) setPx(i, 0);
   }
 
   void fillSeg(uint32_t c) {
-    for (uint16_t i = _segStart; i < _segEnd; i++) setPixelColorScaled(i, c);
+    uint32_t sc = scaleColorLevel(c, 255);
+    for (uint16_t i = _fx->segStart; i < _fx->segEnd; i++) setPx(i, sc);
   }
 
-  uint32_t scaleColor(uint32_t c, float f) {
-    f *= ((float)_bri / 255.0f);
-    if (f <= 0.0f) return 0;
-    if (f > 1.0f) f = 1.0f;
-    float corrected = (_gamma <= 0.101f) ? f : powf(f, _gamma);
-    if (corrected < 0.0f) corrected = 0.0f;
-    if (corrected > 1.0f) corrected = 1.0f;
-    uint8_t r = (c >> 16) & 0xFF;
-    uint8_t g = (c >> 8) & 0xFF;
-    uint8_t b = c & 0xFF;
+  // Fill the segment with one color at a fractional level (0 clears).
+  void fillSegScaled(float f, uint32_t c) {
+    uint32_t sc = scaleColor(c, f);
+    for (uint16_t i = _fx->segStart; i < _fx->segEnd; i++) setPx(i, sc);
+  }
+
+  // Gamma table only changes with setGamma(); this is the one place powf runs.
+  void rebuildGammaLut() {
+    for (uint16_t i = 0; i < 256; i++) {
+      float x = (float)i / 255.0f;
+      float corrected = (_gamma <= 0.101f) ? x : powf(x, _gamma);
+      if (corrected < 0.0f) corrected = 0.0f;
+      if (corrected > 1.0f) corrected = 1.0f;
+      _gammaLut[i] = (uint16_t)(corrected * 65535.0f + 0.5f);
+    }
+    rebuildLevelLut();
+  }
+
+  // Fold brightness into the gamma table; integer-only so per-frame fades stay cheap.
+  void rebuildLevelLut() {
+    for (uint16_t i = 0; i < 256; i++) {
+      _levelLut[i] = _gammaLut[(i * _bri + 127) / 255];
+    }
+  }
+
+  static inline uint8_t scaleChannel(uint32_t ch, uint32_t k) {
+    return (uint8_t)((ch * k + 0x8000u) >> 16);
+  }
+
+  uint32_t scaleColorLevel(uint32_t c, uint8_t level) {
+    uint32_t k = _levelLut[level];
+    if (k == 0) return 0;
+    uint8_t r = scaleChannel((c >> 16) & 0xFF, k);
+    uint8_t g = scaleChannel((c >> 8) & 0xFF, k);
+    uint8_t b = scaleChannel(c & 0xFF, k);
     if (_isRGBW) {
-      uint8_t w = (c >> 24) & 0xFF;
-      return Color((uint8_t)(r * corrected), (uint8_t)(g * corrected), (uint8_t)(b * corrected), (uint8_t)(w * corrected));
+      return Color(r, g, b, scaleChannel((c >> 24) & 0xFF, k));
     } else {
-      return Color((uint8_t)(r * corrected), (uint8_t)(g * corrected), (uint8_t)(b * corrected));
+      return Color(r, g, b);
     }
   }
 
+  uint32_t scaleColor(uint32_t c, float f) {
+    if (f <= 0.0f) return 0;
+    if (f >= 1.0f) return scaleColorLevel(c, 255);
+    return scaleColorLevel(c, (uint8_t)(f * 255.0f + 0.5f));
+  }
+
   void resizeAux() {
     if (_aux) { delete [] _aux; _aux = nullptr; }
     if (_count > 0) { _aux = new uint8_t[_count]; memset(_aux, 0, _count); }
   }
 
+  void markRefresh() {
+    for (auto& seg : _segs) {
+      for (auto& slot : seg.slots) slot.needsRefresh = true;
+    }
+  }
+
+  // Segment buffers are allocated on first use and otherwise only change size
+  // with the strip, never per transition.
+  void allocSegment(Segment& seg) {
+    if (seg.slots[0].fb) return;
+    uint16_t n = max<uint16_t>(_count, 1);
+    for (auto& slot : seg.slots) {
+      slot.fb = new uint32_t[n];
+      memset(slot.fb, 0, n * sizeof(uint32_t));
+    }
+    seg.outCov = new uint8_t[n];
+    memset(seg.outCov, 0, n);
+  }
+
+  void resizeFrameBuffers() {
+    uint16_t n = max<uint16_t>(_count, 1);
+    for (auto& seg : _segs) {
+      if (!seg.slots[0].fb) continue;
+      for (auto& slot : seg.slots) {
+        delete [] slot.fb;
+        slot.fb = new uint32_t[n];
+        memset(slot.fb, 0, n * sizeof(uint32_t));
+      }
+      delete [] seg.outCov;
+      seg.outCov = new uint8_t[n];
+      memset(seg.outCov, 0, n);
+    }
+  }
+
+  static uint32_t transitionMix(const Segment& seg, unsigned long now) {
+    unsigned long elapsed = now - seg.xfadeStartMs;
+    if (elapsed >= seg.xfadeDurMs) return 256;
+    float t = (float)elapsed / (float)seg.xfadeDurMs;
+    return (uint32_t)(t * t * (3.0f - 2.0f * t) * 256.0f);
+  }
+
+  // Start a segment's pending effect; with a transition time set it goes into
+  // the idle slot and the current one becomes the outgoing layer.
+  void applyPending(Segment& seg) {
+    unsigned long now = millis();
+    EffectSlot& prev = seg.slots[seg.cur];
+    if (seg.pXfadeMs > 0) {
+      if (seg.xfadeActive) {
+        // Retargeting mid-transition: freeze the current mix and fade from that.
+        // The snapshot spans both ranges but owns only the pixels either effect
+        // covered, which outCov records.
+        const EffectSlot& out = seg.slots[seg.cur ^ 1];
+        uint32_t mix = transitionMix(seg, now);
+        uint16_t lo = min<uint16_t>(prev.segStart, out.segStart);
+        uint16_t hi = max<uint16_t>(prev.segEnd, out.segEnd);
+        for (uint16_t i = lo; i < hi; i++) {
+          const bool owned = covers(prev, i) || outCovers(seg, out, i);
+          seg.outCov[i] = owned;
+          prev.fb[i] = owned ? blendPixel(out.fb[i], prev.fb[i], mix) : 0;
+        }
+        memset(seg.outCov, 0, lo);
+        memset(seg.outCov + hi, 0, _count - hi);
+        prev.segStart = lo; prev.segEnd = hi;
+      } else if (!prev.active) {
+        // Fade in from black over the incoming range only; the layers below keep the rest
+        memset(prev.fb, 0, max<uint16_t>(_count, 1) * sizeof(uint32_t));
+        memset(seg.outCov, 0, max<uint16_t>(_count, 1));
+        prev.segStart = seg.pStart; prev.segEnd = seg.pEnd;
+      }
+      seg.outFrozen = seg.xfadeActive || !prev.active;
+      seg.cur ^= 1;
+      memset(seg.slots[seg.cur].fb, 0, max<uint16_t>(_count, 1) * sizeof(uint32_t));
+      seg.xfadeActive = true;
+      seg.xfadeStartMs = now;
+      seg.xfadeDurMs = seg.pXfadeMs;
+    } else {
+      seg.xfadeActive = false;
+      seg.slots[seg.cur ^ 1].active = false;
+      // Keep the buffer (trail effects fade from it) but drop pixels the new range no longer covers
+      for (uint16_t i = 0; i < seg.pStart; i++) prev.fb[i] = 0;
+      for (uint16_t i = seg.pEnd; i < _count; i++) prev.fb[i] = 0;
+    }
+    EffectSlot& s = seg.slots[seg.cur];
+    s.active = true;
+    s.segStart = seg.pStart; s.segEnd = seg.pEnd;
+    s.mode = seg.pMode; s.color = seg.pColor; s.speed = seg.pSpeed; s.reverse = seg.pReverse;
+    s.startedMs = now; s.lastFrameMs = 0; s.pos = 0; s.dir = 1; s.phase = 0;
+    // Reset per-mode state on (re)apply
+    if (s.mode == FX_MODE_FILLER_UP) {
+      s.fillerFill = 0;            // number of filled LEDs
+      s.fillerDropAccum = 0.0f;     // distance traveled within current region
+      s.fillerFilling = true;       // currently filling (true) or un-filling (false)
+      s.fillerLastMs = now;         // seed timing
+    }
+    seg.hasPending = false;
+  }
+
+  // Per-channel lerp of two packed pixels, two channels per multiply; mix is 0..256.
+  static inline uint32_t blendPixel(uint32_t a, uint32_t b, uint32_t mix) {
+    uint32_t inv = 256 - mix;
+    uint32_t rb = (((a & 0x00FF00FFu) * inv + (b & 0x00FF00FFu) * mix) >> 8) & 0x00FF00FFu;
+    uint32_t wg = (((a >> 8) & 0x00FF00FFu) * inv + ((b >> 8) & 0x00FF00FFu) * mix) & 0xFF00FF00u;
+    return rb | wg;
+  }
+
+  // Per-channel saturating add of two packed pixels.
+  static inline uint32_t addPixels(uint32_t a, uint32_t b) {
+    uint32_t out = 0;
+    for (uint8_t shift = 0; shift < 32; shift += 8) {
+      uint32_t ch = ((a >> shift) & 0xFF) + ((b >> shift) & 0xFF);
+      out |= (ch > 0xFF ? 0xFFu : ch) << shift;
+    }
+    return out;
+  }
+
+  static inline bool covers(const EffectSlot& slot, uint16_t i) {
+    return i >= slot.segStart && i < slot.segEnd;
+  }
+
+  // Pixels the outgoing layer owns; a frozen retarget snapshot can hold two separate ranges
+  static inline bool outCovers(const Segment& seg, const EffectSlot& out, uint16_t i) {
+    return seg.outFrozen ? seg.outCov[i] != 0 : covers(out, i);
+  }
+
+  // Layer every active segment onto the strip, crossfading segments mid-transition.
+  void composite() {
+    const unsigned long now = millis();
+    bool first = true;
+    for (auto& seg : _segs) {
+      EffectSlot& in = seg.slots[seg.cur];
+      if (!in.active) continue;
+      if (first) {
+        // Pixels no segment covers stay dark
+        if (in.segStart > 0 || in.segEnd < _count || seg.blend != SEG_BLEND_REPLACE || seg.xfadeActive) strip.clear();
+        first = false;
+      }
+      const EffectSlot& out = seg.slots[seg.cur ^ 1];
+      uint32_t mix = 256;
+      uint16_t lo = in.segStart, hi = in.segEnd;
+      if (seg.xfadeActive) {
+        mix = transitionMix(seg, now);
+        if (mix >= 256) {
+          seg.xfadeActive = false;
+          seg.slots[seg.cur ^ 1].active = false;
+        } else {
+          lo = min<uint16_t>(lo, out.segStart);
+          hi = max<uint16_t>(hi, out.segEnd);
+        }
+      }
+      const bool blending = seg.xfadeActive;
+      const uint32_t layerMix = (uint32_t)seg.opacity + (seg.opacity >> 7); // 255 -> 256
+      for (uint16_t i = lo; i < hi; i++) {
+        // Between two disjoint ranges neither effect owns the pixel
+        if (blending && !covers(in, i) && !outCovers(seg, out, i)) continue;
+        uint32_t c = blending ? blendPixel(out.fb[i], in.fb[i], mix) : in.fb[i];
+        switch (seg.blend) {
+          case SEG_BLEND_ADD:
+            if (layerMix < 256) c = blendPixel(0, c, layerMix);
+            strip.setPixelColor(i, addPixels(strip.getPixelColor(i), c));
+            break;
+          case SEG_BLEND_ALPHA:
+            strip.setPixelColor(i, blendPixel(strip.getPixelColor(i), c, layerMix));
+            break;
+          default:
+            strip.setPixelColor(i, c);
+            break;
+        }
+      }
+    }
+    if (first) strip.clear();
+  }
+
   uint32_t wheel(uint8_t pos) const {
     pos = 255 - pos;
     if (pos < 85) {
@@ -258,8 +622,8 @@ private:
   void dimAll(uint8_t amount) {
     uint16_t n = segLen();
     for (uint16_t i = 0; i < n; i++) {
-      uint16_t p = _segStart + i;
-      uint32_t c = strip.getPixelColor(p);
+      uint16_t p = _fx->segStart + i;
+      uint32_t c = _fx->fb[p];
       uint8_t r = (c >> 16) & 0xFF;
       uint8_t g = (c >> 8) & 0xFF;
       uint8_t b = c & 0xFF;
@@ -269,41 +633,41 @@ private:
       g = (uint8_t)((g * (255 - amount)) >> 8);
       b = (uint8_t)((b * (255 - amount)) >> 8);
       w = (uint8_t)((w * (255 - amount)) >> 8);
-      strip.setPixelColor(p, Color(r,g,b,w));
+      setPx(p, Color(r,g,b,w));
     #else
       r = (uint8_t)((r * (255 - amount)) >> 8);
       g = (uint8_t)((g * (255 - amount)) >> 8);
       b = (uint8_t)((b * (255 - amount)) >> 8);
-      strip.setPixelColor(p, Color(r,g,b));
+      setPx(p, Color(r,g,b));
     #endif
     }
   }
 
   inline void setPixelColorScaled(uint16_t p, uint32_t c) {
-    strip.setPixelColor(p, scaleColor(c, 1.0f));
+    setPx(p, scaleColorLevel(c, 255));
   }
 
   inline void setPixelScaled(uint16_t p, float f, uint32_t c) {
-    if (p >= _segStart && p < _segEnd) {
+    if (p >= _fx->segStart && p < _fx->segEnd) {
       if (f <= 0.0f) return;
       if (f > 1.0f) f = 1.0f;
       uint32_t sc = scaleColor(c, f);
-      strip.setPixelColor(p, sc);
+      setPx(p, sc);
     }
   }
 
   inline void addPixelScaled(uint16_t p, float f, uint32_t c) {
-    if (p < _segStart || p >= _segEnd || f <= 0.0f) return;
+    if (p < _fx->segStart || p >= _fx->segEnd || f <= 0.0f) return;
     uint32_t sc = scaleColor(c, f);
-    uint32_t cur = strip.getPixelColor(p);
+    uint32_t cur = _fx->fb[p];
     uint16_t r = ((cur >> 16) & 0xFF) + ((sc >> 16) & 0xFF);
     uint16_t g = ((cur >> 8) & 0xFF) + ((sc >> 8) & 0xFF);
     uint16_t b = (cur & 0xFF) + (sc & 0xFF);
     if (_isRGBW) {
       uint16_t w = ((cur >> 24) & 0xFF) + ((sc >> 24) & 0xFF);
-      strip.setPixelColor(p, Color(min<uint16_t>(r, 255), min<uint16_t>(g, 255), min<uint16_t>(b, 255), min<uint16_t>(w, 255)));
+      setPx(p, Color(min<uint16_t>(r, 255), min<uint16_t>(g, 255), min<uint16_t>(b, 255), min<uint16_t>(w, 255)));
     } else {
-      strip.setPixelColor(p, Color(min<uint16_t>(r, 255), min<uint16_t>(g, 255), min<uint16_t>(b, 255)));
+      setPx(p, Color(min<uint16_t>(r, 255), min<uint16_t>(g, 255), min<uint16_t>(b, 255)));
     }
   }
 
@@ -317,38 +681,46 @@ private:
       if (f <= 0.0f) continue;
       f = f * f;
       f *= intensity;
-      uint16_t p = _segStart + (uint16_t)i;
+      uint16_t p = _fx->segStart + (uint16_t)i;
       if (additive) addPixelScaled(p, f, color);
       else setPixelScaled(p, f, color);
     }
   }
 
   uint16_t getFrameIntervalMs() const {
-    switch (_mode) {
+    switch (_fx->mode) {
       case FX_MODE_STATIC:
         return 1000;
       case FX_MODE_BLINK:
-        return constrain(_speed / 12, 20, 80);
+        return constrain(_fx->speed / 12, 20, 80);
       case FX_MODE_COLOR_WIPE:
       case FX_MODE_COLOR_WIPE_INVERSE:
       case FX_MODE_COLOR_WIPE_RANDOM:
       case FX_MODE_THEATER_CHASE:
       case FX_MODE_FILLER_UP: {
         uint16_t n = max<uint16_t>(segLen(), 1);
-        return constrain(_speed / max<uint16_t>(n * 6, 1), 6, 24);
+        return constrain(_fx->speed / max<uint16_t>(n * 6, 1), 6, 24);
       }
       default:
-        return constrain(_speed / 240, 4, 16);
+        return constrain(_fx->speed / 240, 4, 16);
     }
   }
 
-  void renderFrame(bool force) {
-    if (!force && _mode == FX_MODE_STATIC && !_needsRefresh) return;
+  // Render one slot into its buffer if its frame is due; returns true when it drew.
+  bool renderSlot(EffectSlot& slot, bool force) {
+    if (!slot.active) return false;
+    _fx = &slot;
     unsigned long now = millis();
-    uint16_t frameMs = getFrameIntervalMs();
-    if (!force && (now - _lastFrameMs) < frameMs) return;
-    _lastFrameMs = now;
-    switch (_mode) {
+    if (!force) {
+      if (_fx->mode == FX_MODE_STATIC) {
+        if (!_fx->needsRefresh) return false;
+      } else if ((now - _fx->lastFrameMs) < getFrameIntervalMs()) {
+        return false;
+      }
+    }
+    _fx->lastFrameMs = now;
+    _fx->needsRefresh = false;
+    switch (_fx->mode) {
       case FX_MODE_STATIC: renderStatic(); break;
       case FX_MODE_BREATH: renderBreath(now); break;
       case FX_MODE_COLOR_WIPE: renderColorWipe(now); break;
@@ -370,49 +742,47 @@ private:
       case FX_MODE_FILLER_UP: renderFillerUp(now); break;
       default: renderStatic(); break;
     }
-    strip.show();
-    _needsRefresh = false;
+    return true;
   }
 
   void renderStatic() {
-    fillSeg(_color);
+    fillSeg(_fx->color);
   }
 
   void renderBreath(unsigned long now) {
-    float period = max<uint16_t>(_speed, 1000);
-    float t = (float)((now - _startedMs) % (unsigned long)period) / period;
+    float period = max<uint16_t>(_fx->speed, 1000);
+    float t = (float)((now - _fx->startedMs) % (unsigned long)period) / period;
     float s = (cosf(t * 6.28318f) * -0.5f) + 0.5f;
     float eased = s * s * (3.0f - 2.0f * s);
     float f = 0.14f + (0.86f * eased);
-    clearSeg();
-    for (uint16_t i = _segStart; i < _segEnd; i++) setPixelScaled(i, f, _color);
+    fillSegScaled(f, _fx->color);
   }
 
   void renderColorWipe(unsigned long now, bool inverse=false) {
     uint16_t n = segLen(); if (n == 0) return;
-    unsigned long elapsed = now - _startedMs;
-    uint16_t stepMs = max<uint16_t>(_speed / max<uint16_t>(n, 1), 15);
+    unsigned long elapsed = now - _fx->startedMs;
+    uint16_t stepMs = max<uint16_t>(_fx->speed / max<uint16_t>(n, 1), 15);
     int idx = (int)(elapsed / stepMs);
-    if (inverse ^ _reverse) idx = n - 1 - (idx % (n + 1));
+    if (inverse ^ _fx->reverse) idx = n - 1 - (idx % (n + 1));
     clearSeg();
     int limit = min<int>(idx, n);
     for (int i = 0; i < limit; i++) {
-      uint16_t p = _segStart + ((inverse ^ _reverse) ? (n - 1 - i) : i);
-      setPixelColorScaled(p, _color);
+      uint16_t p = _fx->segStart + ((inverse ^ _fx->reverse) ? (n - 1 - i) : i);
+      setPixelColorScaled(p, _fx->color);
     }
   }
 
   void renderTheaterChase(unsigned long now) {
     uint16_t n = segLen(); if (n == 0) return;
-    uint16_t stepMs = max<uint16_t>(_speed / 50, 30);
+    uint16_t stepMs = max<uint16_t>(_fx->speed / 50, 30);
     int offset = (now / stepMs) % 3;
     clearSeg();
     for (uint16_t i = 0; i < n; i++) {
-      uint16_t j = _reverse ? (n - 1 - i) : i;
+      uint16_t j = _fx->reverse ? (n - 1 - i) : i;
       if ((j + offset) % 3 == 0) {
-        setPixelColorScaled(_segStart + i, _color);
+        setPixelColorScaled(_fx->segStart + i, _fx->color);
       } else if ((j + offset + 1) % 3 == 0) {
-        setPixelScaled(_segStart + i, 0.18f, _color);
+        setPixelScaled(_fx->segStart + i, 0.18f, _fx->color);
       }
     }
   }
@@ -420,82 +790,81 @@ private:
   void renderScan(unsigned long now) {
     uint16_t n = segLen(); if (n < 1) return;
     clearSeg();
-    if (n == 1) { setPixelColorScaled(_segStart, _color); return; }
-    float period = (float)max<uint16_t>(_speed, 300);
+    if (n == 1) { setPixelColorScaled(_fx->segStart, _fx->color); return; }
+    float period = (float)max<uint16_t>(_fx->speed, 300);
     float path = (float)(2 * (int)n - 2);
-    float t = fmodf(((now - _startedMs) % (unsigned long)period) / period * path, path);
+    float t = fmodf(((now - _fx->startedMs) % (unsigned long)period) / period * path, path);
     float pos = (t <= (n - 1)) ? t : (2 * (n - 1) - t);
-    if (_reverse) pos = (n - 1) - pos;
-    renderSoftDot(pos, _color, 3.4f, false);
+    if (_fx->reverse) pos = (n - 1) - pos;
+    renderSoftDot(pos, _fx->color, 3.4f, false);
   }
 
   void renderDualScan(unsigned long now) {
     uint16_t n = segLen(); if (n < 1) return;
     clearSeg();
-    if (n == 1) { setPixelColorScaled(_segStart, _color); return; }
-    float period = (float)max<uint16_t>(_speed, 300);
+    if (n == 1) { setPixelColorScaled(_fx->segStart, _fx->color); return; }
+    float period = (float)max<uint16_t>(_fx->speed, 300);
     float path = (float)(2 * (int)n - 2);
-    float t = fmodf(((now - _startedMs) % (unsigned long)period) / period * path, path);
+    float t = fmodf(((now - _fx->startedMs) % (unsigned long)period) / period * path, path);
     float pos = (t <= (n - 1)) ? t : (2 * (n - 1) - t);
-    float posA = _reverse ? ((n - 1) - pos) : pos;
+    float posA = _fx->reverse ? ((n - 1) - pos) : pos;
     float posB = (n - 1) - posA;
-    renderSoftDot(posA, _color, 2.8f, true);
-    renderSoftDot(posB, _color, 2.8f, true);
+    renderSoftDot(posA, _fx->color, 2.8f, true);
+    renderSoftDot(posB, _fx->color, 2.8f, true);
   }
 
   void renderBlink(unsigned long now) {
-    unsigned long period = max<uint16_t>(_speed, 300);
-    bool on = ((now - _startedMs) % period) < (period / 2);
-    fillSeg(on ? _color : 0);
+    unsigned long period = max<uint16_t>(_fx->speed, 300);
+    bool on = ((now - _fx->startedMs) % period) < (period / 2);
+    fillSeg(on ? _fx->color : 0);
   }
 
   void renderFade(unsigned long now) {
-    float period = max<uint16_t>(_speed, 1000);
-    float t = (float)((now - _startedMs) % (unsigned long)period) / period;
+    float period = max<uint16_t>(_fx->speed, 1000);
+    float t = (float)((now - _fx->startedMs) % (unsigned long)period) / period;
     float f = (sinf((t * 2.0f - 1.0f) * 1.5708f) + 1.0f) * 0.5f;
-    clearSeg();
-    for (uint16_t i = _segStart; i < _segEnd; i++) setPixelScaled(i, f, _color);
+    fillSegScaled(f, _fx->color);
   }
 
   void renderRainbow(unsigned long now, bool cycle) {
     uint16_t n = segLen(); if (n == 0) return;
-    uint16_t stepMs = max<uint16_t>(_speed / 100, 5);
-    uint32_t offset = (now - _startedMs) / stepMs;
+    uint16_t stepMs = max<uint16_t>(_fx->speed / 100, 5);
+    uint32_t offset = (now - _fx->startedMs) / stepMs;
     for (uint16_t i = 0; i < n; i++) {
       uint16_t idx = cycle ? ((i * 256 / n) + offset) & 0xFF : ((i + offset) & 0xFF);
       uint32_t c = wheel(idx);
-      setPixelColorScaled(_segStart + (_reverse ? (n - 1 - i) : i), c);
+      setPixelColorScaled(_fx->segStart + (_fx->reverse ? (n - 1 - i) : i), c);
     }
   }
 
   void renderComet(unsigned long now) {
     uint16_t n = segLen(); if (n == 0) return;
     clearSeg();
-    float period = (float)max<uint16_t>(_speed, 300);
-    float t = ((now - _startedMs) % (unsigned long)period) / period;
+    float period = (float)max<uint16_t>(_fx->speed, 300);
+    float t = ((now - _fx->startedMs) % (unsigned long)period) / period;
     float pos = t * (float)(n - 1);
-    if (_reverse) pos = (float)(n - 1) - pos;
+    if (_fx->reverse) pos = (float)(n - 1) - pos;
     float tailLen = 5.8f;
     for (uint16_t i = 0; i < n; i++) {
       float pixelPos = (float)i;
-      float behind = _reverse ? (pixelPos - pos) : (pos - pixelPos);
+      float behind = _fx->reverse ? (pixelPos - pos) : (pos - pixelPos);
       if (behind <= 0.0f || behind > tailLen) continue;
       float mix = 1.0f - (behind / tailLen);
       mix = mix * mix * (3.0f - 2.0f * mix);
-      addPixelScaled(_segStart + i, 0.48f * mix, _color);
+      addPixelScaled(_fx->segStart + i, 0.48f * mix, _fx->color);
     }
-    renderSoftDot(pos, _color, 2.2f, true, 1.0f);
+    renderSoftDot(pos, _fx->color, 2.2f, true, 1.0f);
   }
 
   void renderRunningLights(unsigned long now) {
     uint16_t n = segLen(); if (n == 0) return;
-    uint16_t period = max<uint16_t>(_speed, 100);
-    // Use _speed as the time for one complete wave cycle
-    float t = (now - _startedMs) * (6.28318f / (float)period); // 2*PI / period
+    uint16_t period = max<uint16_t>(_fx->speed, 100);
+    // Use speed as the time for one complete wave cycle
+    float t = (now - _fx->startedMs) * (6.28318f / (float)period); // 2*PI / period
     for (uint16_t i = 0; i < n; i++) {
       float v = (sinf((i * 0.3f) + t) + 1.0f) * 0.5f;
-      uint32_t c = scaleColor(_color, v);
-      strip.setPixelColor(_segStart + (_reverse ? (n - 1 - i) : i), c);
+      uint32_t c = scaleColor(_fx->color, v);
+      setPx(_fx->segStart + (_fx->reverse ? (n - 1 - i) : i), c);
     }
   }
 
@@ -503,93 +872,93 @@ private:
   // After all color is collected, it does the same with black. Uses smooth sub-pixel positioning.
   void renderFillerUp(unsigned long now) {
     uint16_t n = segLen(); if (n == 0) return;
-    uint32_t T = (uint32_t)max<uint16_t>(_speed, 1); // total cycle duration (ms)
+    uint32_t T = (uint32_t)max<uint16_t>(_fx->speed, 1); // total cycle duration (ms)
 
     // Determine velocity so that traversing lengths n, n-1, ..., 1 takes T/2 ms
     // v (led/ms) = n(n+1)/T
     float v = ((float)n * (float)(n + 1)) / (float)T;
 
     // Advance drop accumulator by elapsed time
-    unsigned long dt = now - _fillerLastMs;
-    _fillerLastMs = now;
+    unsigned long dt = now - _fx->fillerLastMs;
+    _fx->fillerLastMs = now;
     if (dt > 200) dt = 200; // avoid long-jump artifacts
-    _fillerDropAccum += v * (float)dt; // in LEDs
+    _fx->fillerDropAccum += v * (float)dt; // in LEDs
 
-    auto regionLen = [&]() -> uint16_t { return (uint16_t)(n - _fillerFill); };
+    auto regionLen = [&]() -> uint16_t { return (uint16_t)(n - _fx->fillerFill); };
 
     // Consume full traversals; when drop reaches the boundary, grow collected region
     uint16_t rlen = regionLen();
     if (rlen == 0) {
       // switch phase immediately
-      _fillerFilling = !_fillerFilling;
-      _fillerFill = 0;
-      _fillerDropAccum = 0.0f;
+      _fx->fillerFilling = !_fx->fillerFilling;
+      _fx->fillerFill = 0;
+      _fx->fillerDropAccum = 0.0f;
       rlen = regionLen();
     }
-    while (rlen > 0 && _fillerDropAccum >= (float)rlen) {
-      _fillerDropAccum -= (float)rlen;
-      _fillerFill++;
-      if (_fillerFill >= n) {
+    while (rlen > 0 && _fx->fillerDropAccum >= (float)rlen) {
+      _fx->fillerDropAccum -= (float)rlen;
+      _fx->fillerFill++;
+      if (_fx->fillerFill >= n) {
         // completed half-cycle; switch phase
-        _fillerFilling = !_fillerFilling;
-        _fillerFill = 0;
-        _fillerDropAccum = 0.0f;
+        _fx->fillerFilling = !_fx->fillerFilling;
+        _fx->fillerFill = 0;
+        _fx->fillerDropAccum = 0.0f;
       }
       rlen = regionLen();
     }
 
     // Render frame baseline and collected region
-    if (_fillerFilling) {
+    if (_fx->fillerFilling) {
       // Phase 1: collect color at the end; background is black
       fillSeg(BLACK);
-      if (_fillerFill > 0) {
-        if (!_reverse) {
-          for (uint16_t i = 0; i < _fillerFill; i++) {
-            setPixelColorScaled(_segStart + (n - 1 - i), _color);
+      if (_fx->fillerFill > 0) {
+        if (!_fx->reverse) {
+          for (uint16_t i = 0; i < _fx->fillerFill; i++) {
+            setPixelColorScaled(_fx->segStart + (n - 1 - i), _fx->color);
           }
         } else {
-          for (uint16_t i = 0; i < _fillerFill; i++) {
-            setPixelColorScaled(_segStart + i, _color);
+          for (uint16_t i = 0; i < _fx->fillerFill; i++) {
+            setPixelColorScaled(_fx->segStart + i, _fx->color);
           }
         }
       }
       // Drop flies in across the uncollected region toward the end with smooth interpolation
       if (rlen > 0) {
-        float dropPos = min<float>(_fillerDropAccum, (float)(rlen - 1));
+        float dropPos = min<float>(_fx->fillerDropAccum, (float)(rlen - 1));
         int i0 = (int)floorf(dropPos);
         float frac = dropPos - (float)i0;
-        uint16_t p0 = !_reverse ? (_segStart + i0) : (_segStart + (n - 1 - i0));
-        uint16_t p1 = !_reverse ? (_segStart + min<int>(i0 + 1, rlen - 1)) : (_segStart + (n - 1 - min<int>(i0 + 1, rlen - 1)));
-        setPixelScaled(p0, 1.0f, _color);
-        if (p1 != p0) setPixelScaled(p1, frac, _color);
+        uint16_t p0 = !_fx->reverse ? (_fx->segStart + i0) : (_fx->segStart + (n - 1 - i0));
+        uint16_t p1 = !_fx->reverse ? (_fx->segStart + min<int>(i0 + 1, rlen - 1)) : (_fx->segStart + (n - 1 - min<int>(i0 + 1, rlen - 1)));
+        setPixelScaled(p0, 1.0f, _fx->color);
+        if (p1 != p0) setPixelScaled(p1, frac, _fx->color);
       }
     } else {
       // Phase 2: collect black at the end; background is full color
-      fillSeg(_color);
-      if (_fillerFill > 0) {
-        if (!_reverse) {
-          for (uint16_t i = 0; i < _fillerFill; i++) {
-            setPixelColorScaled(_segStart + (n - 1 - i), BLACK);
+      fillSeg(_fx->color);
+      if (_fx->fillerFill > 0) {
+        if (!_fx->reverse) {
+          for (uint16_t i = 0; i < _fx->fillerFill; i++) {
+            setPixelColorScaled(_fx->segStart + (n - 1 - i), BLACK);
           }
         } else {
-          for (uint16_t i = 0; i < _fillerFill; i++) {
-            setPixelColorScaled(_segStart + i, BLACK);
+          for (uint16_t i = 0; i < _fx->fillerFill; i++) {
+            setPixelColorScaled(_fx->segStart + i, BLACK);
           }
         }
       }
       // Black drop flies in across the remaining colored region toward the end with smooth interpolation
       if (rlen > 0) {
-        float dropPos = min<float>(_fillerDropAccum, (float)(rlen - 1));
+        float dropPos = min<float>(_fx->fillerDropAccum, (float)(rlen - 1));
         int i0 = (int)floorf(dropPos);
         float frac = dropPos - (float)i0;
-        uint16_t p0 = !_reverse ? (_segStart + i0) : (_segStart + (n - 1 - i0));
-        uint16_t p1 = !_reverse ? (_segStart + min<int>(i0 + 1, rlen - 1)) : (_segStart + (n - 1 - min<int>(i0 + 1, rlen - 1)));
+        uint16_t p0 = !_fx->reverse ? (_fx->segStart + i0) : (_fx->segStart + (n - 1 - i0));
+        uint16_t p1 = !_fx->reverse ? (_fx->segStart + min<int>(i0 + 1, rlen - 1)) : (_fx->segStart + (n - 1 - min<int>(i0 + 1, rlen - 1)));
         // Create smooth black drop: p1 is fully black (head), p0 fades from color to black
         if (p1 != p0) {
-          setPixelScaled(p0, frac, _color); // trailing edge: more black as drop advances
+          setPixelScaled(p0, frac, _fx->color); // trailing edge: more black as drop advances
           setPixelColorScaled(p1, BLACK);    // drop head is fully black
         } else {
-          setPixelScaled(p0, 1.0f - frac, _color); // single pixel fades to black
+          setPixelScaled(p0, 1.0f - frac, _fx->color); // single pixel fades to black
         }
       }
     }
@@ -599,11 +968,11 @@ private:
     uint16_t n = segLen(); if (n == 0) return;
     dimAll(40);
     // Use speed to control twinkle frequency: higher speed = slower twinkling
-    uint16_t period = max<uint16_t>(_speed, 100);
+    uint16_t period = max<uint16_t>(_fx->speed, 100);
     uint16_t chance = constrain(100000 / period, 1, 100); // slower = less frequent
     if (random(100) < chance) {
-      uint16_t i = _segStart + random(n);
-      setPixelColorScaled(i, _color);
+      uint16_t i = _fx->segStart + random(n);
+      setPixelColorScaled(i, _fx->color);
     }
   }
 
@@ -611,13 +980,13 @@ private:
     uint16_t n = segLen(); if (n == 0) return;
     clearSeg();
     // Use speed to control sparkle frequency: higher speed = slower sparkling
-    uint16_t period = max<uint16_t>(_speed, 100);
+    uint16_t period = max<uint16_t>(_fx->speed, 100);
     uint16_t chance = constrain(100000 / period, 1, 100);
     if (random(100) < chance) {
       uint8_t sparks = 1 + (random(100) < 30 ? 1 : 0);
       for (uint8_t s = 0; s < sparks; s++) {
-        uint16_t i = _segStart + random(n);
-        setPixelColorScaled(i, _color);
+        uint16_t i = _fx->segStart + random(n);
+        setPixelColorScaled(i, _fx->color);
       }
     }
   }
@@ -625,44 +994,43 @@ private:
   void renderConfetti(unsigned long now) {
     uint16_t n = segLen(); if (n == 0) return;
     // Use speed to control confetti spawn rate: higher speed = slower confetti
-    uint16_t period = max<uint16_t>(_speed, 100);
+    uint16_t period = max<uint16_t>(_fx->speed, 100);
     uint16_t dimRate = constrain(200000 / period, 10, 80); // slower = less dimming
     dimAll(dimRate);
     // Spawn probability: faster speed = more confetti per frame
     uint16_t chance = constrain(100000 / period, 5, 100);
     if (random(100) < chance) {
-      uint16_t i = _segStart + random(n);
-      setPixelColorScaled(i, _color);
+      uint16_t i = _fx->segStart + random(n);
+      setPixelColorScaled(i, _fx->color);
     }
   }
 
   void renderFireFlicker(unsigned long now) {
     uint16_t n = segLen(); if (n == 0) return;
     // Use speed to control flicker intensity: higher speed = slower, gentler flicker
-    uint16_t period = max<uint16_t>(_speed, 100);
+    uint16_t period = max<uint16_t>(_fx->speed, 100);
     uint8_t maxFlicker = constrain(120000 / period, 20, 120); // slower = less flicker variation
     for (uint16_t i = 0; i < n; i++) {
       uint8_t flicker = random(maxFlicker);
-      float f = 1.0f - (flicker / 255.0f);
-      uint32_t c = scaleColor(_color, f);
-      strip.setPixelColor(_segStart + i, c);
+      uint32_t c = scaleColorLevel(_fx->color, 255 - flicker);
+      setPx(_fx->segStart + i, c);
     }
   }
 
   void renderColorWipeRandom(unsigned long now) {
     uint16_t n = segLen(); if (n == 0) return;
-    unsigned long elapsed = now - _startedMs;
-    uint16_t stepMs = max<uint16_t>(_speed / max<uint16_t>(n, 1), 15);
+    unsigned long elapsed = now - _fx->startedMs;
+    uint16_t stepMs = max<uint16_t>(_fx->speed / max<uint16_t>(n, 1), 15);
     int idx = (int)(elapsed / stepMs);
-    if ((uint16_t)idx != _wipeIndex) {
-      _wipeIndex = (uint16_t)idx;
-      _wipeColor = wheel(random(256));
+    if ((uint16_t)idx != _fx->wipeIndex) {
+      _fx->wipeIndex = (uint16_t)idx;
+      _fx->wipeColor = wheel(random(256));
     }
     clearSeg();
     int limit = min<int>(idx, n);
     for (int i = 0; i < limit; i++) {
-      uint16_t p = _segStart + (_reverse ? (n - 1 - i) : i);
-      setPixelColorScaled(p, _wipeColor);
+      uint16_t p = _fx->segStart + (_fx->reverse ? (n - 1 - i) : i);
+      setPixelColorScaled(p, _fx->wipeColor);
     }
   }
 };
@@ -15,15 +15,23 @@
 #endif
 #include <EEPROM.h>
 #include <time.h>
+#include "esp_sntp.h"
+#include "lwip/sockets.h"
 #include <math.h>
 #include <stdarg.h>
+#include <atomic>
 #include "esp_freertos_hooks.h"
 #include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/semphr.h"
+#include "freertos/event_groups.h"
 #include "config.h"
 #include "led_effects.h"
+#include "request_builder.h"
+#include "route_table.h"
+#include "frame_snapshot.h"
 #include "generated/embedded_assets.h"
+#include "ui_bundle.h"
 #ifndef VERBOSE_LOG
 #define VERBOSE_LOG 0
 #endif
@@ -46,7 +54,130 @@ String gOtaSharedKey;
 
 // Available if we later add a DNS-based captive portal
 DNSServer dnsServer;
-WebServer server(80);
+
+// WebServer that can hand its current connection to another owner, so a
+// long-lived response (the LED stream) does not hold up later requests.
+//
+// It also accepts connections itself. Stock WebServer takes one socket at a
+// time and parks on it until the request arrives (up to HTTP_MAX_DATA_WAIT),
+// so one slow phone or an idle browser preconnect stalls every other client.
+// Here accepted sockets wait in a small queue and are only peeked at; the
+// oldest one whose request has fully arrived goes to WebServer, which then
+// parses and answers it without waiting on the network.
+class StatusGlowWebServer : public WebServer {
+public:
+	using WebServer::WebServer;
+	WiFiClient detachClient() {
+		WiFiClient c = _currentClient;
+		_currentClient = WiFiClient();
+		return c;
+	}
+
+	// Hides WebServer::handleClient(); called from appTask only
+	void handleClient() {
+		acceptQueuedClients();
+		if (_currentStatus == HC_NONE) {
+			QueuedClient* next = nextReadyClient();
+			// Nothing complete yet: return rather than let WebServer accept and wait itself
+			if (!next) return;
+			_currentClient = next->client;
+			_currentStatus = HC_WAIT_READ;
+			_statusChange = millis();
+			*next = QueuedClient();
+		}
+		WebServer::handleClient();
+	}
+
+	// Hide WebServer::on(): exact paths go into one sorted table instead of a
+	// chain of handlers that is walked for every request
+	void on(const char* uri, HTTPMethod method, THandlerFunction fn) {
+		on(uri, method, fn, nullptr);
+	}
+	void on(const char* uri, HTTPMethod method, THandlerFunction fn, THandlerFunction ufn) {
+		if (!_routes) {
+			_routes = new RouteTable<WEB_ROUTE_CAPACITY>(); // owned by WebServer once added
+			addHandler(_routes);
+		}
+		if (!_routes->add(uri, method, fn, ufn)) WebServer::on(uri, method, fn, ufn);
+	}
+
+	// Status line and headers for a body the caller writes itself. WebServer::send()
+	// with an empty body would log "content length is zero" on every call.
+	void sendHeaders(int code, const char* contentType, size_t contentLength) {
+		String header;
+		_prepareHeader(header, code, contentType, contentLength);
+		_currentClientWrite(header.c_str(), header.length());
+	}
+
+	uint8_t queuedClientCount() const {
+		uint8_t n = 0;
+		for (const auto& q : _queued) n += q.used ? 1 : 0;
+		return n;
+	}
+
+private:
+	struct QueuedClient {
+		WiFiClient client;
+		unsigned long acceptedMs = 0;
+		bool used = false;
+	};
+	QueuedClient _queued[WEB_PENDING_CLIENTS];
+	RouteTable<WEB_ROUTE_CAPACITY>* _routes = nullptr;
+	char _peekBuf[WEB_PEEK_BYTES + 1];
+
+	void acceptQueuedClients() {
+		const unsigned long now = millis();
+		for (auto& q : _queued) {
+			if (!q.used) continue;
+			const bool stale = (now - q.acceptedMs) > WEB_PENDING_TIMEOUT_MS && !isRequestReady(q);
+			if (!q.client.connected() || stale) {
+				q.client.stop();
+				q = QueuedClient();
+			}
+		}
+		for (auto& q : _queued) {
+			if (q.used) continue;
+			WiFiClient client = _server.available();
+			if (!client) break;
+			q.client = client;
+			q.acceptedMs = now;
+			q.used = true;
+		}
+	}
+
+	// True once the request head, and a body small enough to wait for, are in the socket buffer
+	bool isRequestReady(QueuedClient& q) {
+		const int queued = q.client.available();
+		if (queued <= 0) return false;
+		// lwIP peeks one segment at most; anything beyond it is already buffered too
+		const int n = recv(q.client.fd(), _peekBuf, WEB_PEEK_BYTES, MSG_PEEK | MSG_DONTWAIT);
+		if (n <= 0) return false;
+		if (n >= WEB_PEEK_BYTES) return true;
+		_peekBuf[n] = '\0';
+		const char* headEnd = strstr(_peekBuf, "\r\n\r\n");
+		if (!headEnd) return queued > n;
+		const int headLen = (headEnd - _peekBuf) + 4;
+		long bodyLen = 0;
+		for (const char* line = strstr(_peekBuf, "\r\n"); line && line < headEnd; line = strstr(line + 2, "\r\n")) {
+			if (strncasecmp(line + 2, "Content-Length:", 15) == 0) {
+				bodyLen = strtol(line + 17, nullptr, 10);
+				break;
+			}
+		}
+		// Uploads are streamed by WebServer; only small bodies are waited for here
+		return bodyLen <= 0 || bodyLen > WEB_PEEK_BYTES || queued >= headLen + bodyLen;
+	}
+
+	QueuedClient* nextReadyClient() {
+		QueuedClient* oldest = nullptr;
+		for (auto& q : _queued) {
+			if (!q.used || !isRequestReady(q)) continue;
+			if (!oldest || (long)(q.acceptedMs - oldest->acceptedMs) < 0) oldest = &q;
+		}
+		return oldest;
+	}
+};
+StatusGlowWebServer server(80);
 
 // App parameters. General settings/effects live in unified app_cfg JSON.
 // Wi-Fi credentials and auth tokens are intentionally stored in separate keys.
@@ -86,6 +217,10 @@ static void loadWifiPrefs();
 void removeContext();
 void onWifiConnected();
 void updateStatusLed();
+static void postEffectsBrightness(uint8_t bri);
+static void postEffectsGamma(float gamma);
+static void postEffectsLength(uint16_t length);
+static void postEffectsPixelType(bool isRGBW);
 
 // NeoPixel strip / effects engine
 // Note: Compiled to support both RGB and RGBW, switchable at runtime
@@ -107,10 +242,14 @@ static Adafruit_NeoPixel* gStatusLed = nullptr;
 bool gStatusLedEnabled = DEFAULT_STATUS_LED_ENABLED;
 static uint32_t gStatusLedLastColor = 0xFFFFFFFFu;
 
-// Guard concurrent access to effects and fade state
-static SemaphoreHandle_t gEffectsMutex = nullptr;
-#define EFFECTS_LOCK()   do { if (gEffectsMutex) xSemaphoreTake(gEffectsMutex, portMAX_DELAY); } while(0)
-#define EFFECTS_UNLOCK() do { if (gEffectsMutex) xSemaphoreGive(gEffectsMutex); } while(0)
+// The render task owns `effects` and the fade state. Other tasks post commands
+// through gEffectsQueue and read pixels from gFrameSnapshot, never from the strip.
+static QueueHandle_t gEffectsQueue = nullptr;
+#define EFFECTS_QUEUE_DEPTH 16
+static FrameSnapshot gFrameSnapshot;
+
+// Web UI served from the uibundle partition when present (see ui_bundle.h)
+static UiBundle gUiBundle;
 
 // Lightweight logs ring buffer (kept in RAM)
 #define LOG_CAPACITY 120
@@ -227,6 +366,57 @@ EffectProfile* findProfile(const String& k) {
 	return nullptr;
 }
 
+// Multi-user presence: with user IDs configured, one getPresencesByUserId call
+// replaces /me/presence. Users either share the strip as equal segments or are
+// folded into the single highest-priority activity.
+enum PresenceLayout : uint8_t {
+	PRESENCE_LAYOUT_AGGREGATE = 0,
+	PRESENCE_LAYOUT_SEGMENTS = 1
+};
+
+struct PresenceUser {
+	String id;
+	String availability;
+	String activity;
+	String shownActivity; // what its segment currently shows (segments layout)
+};
+
+static PresenceUser gPresenceUsers[PRESENCE_MAX_USERS];
+static uint8_t gPresenceUserCount = 0;
+static PresenceLayout gPresenceLayout = PRESENCE_LAYOUT_AGGREGATE;
+static uint8_t gPresenceSegmentsShown = 0;  // engine segments driven by the segments layout
+static uint16_t gPresenceSegmentsLeds = 0;  // strip length they were laid out for
+static uint8_t gPresenceSegmentsBri = 0;    // strip brightness they were dimmed against
+
+// Replace the user list from a JSON array of IDs; returns true when it changed
+static bool setPresenceUsersFromJson(JsonVariantConst value) {
+	String ids[PRESENCE_MAX_USERS];
+	uint8_t count = 0;
+	if (value.is<JsonArrayConst>()) {
+		for (JsonVariantConst v : value.as<JsonArrayConst>()) {
+			if (count >= PRESENCE_MAX_USERS) break;
+			String id = v.as<String>();
+			id.trim();
+			if (id.length()) ids[count++] = id;
+		}
+	}
+	bool changed = (count != gPresenceUserCount);
+	for (uint8_t i = 0; i < count && !changed; ++i) {
+		changed = !ids[i].equalsIgnoreCase(gPresenceUsers[i].id);
+	}
+	if (!changed) return false;
+	for (uint8_t i = 0; i < PRESENCE_MAX_USERS; ++i) {
+		gPresenceUsers[i] = PresenceUser();
+		if (i < count) gPresenceUsers[i].id = ids[i];
+	}
+	gPresenceUserCount = count;
+	return true;
+}
+
+static PresenceLayout parsePresenceLayout(const String& layout) {
+	return layout.equals("segments") ? PRESENCE_LAYOUT_SEGMENTS : PRESENCE_LAYOUT_AGGREGATE;
+}
+
 static void resetAppConfigToDefaults() {
 	memset(paramClientIdValue, 0, sizeof(paramClientIdValue));
 	memset(paramTenantValue, 0, sizeof(paramTenantValue));
@@ -239,10 +429,12 @@ static void resetAppConfigToDefaults() {
 	gGamma = DEFAULT_GAMMA;
 	gLedTypeRGBW = DEFAULT_LED_TYPE_RGBW;
 	gStatusLedEnabled = DEFAULT_STATUS_LED_ENABLED;
-	effects.setLength(numberLeds);
-	effects.setBrightness(gDefaultBrightness);
-	effects.setGamma(gGamma);
-	effects.setPixelType(gLedTypeRGBW);
+	gPresenceLayout = PRESENCE_LAYOUT_AGGREGATE;
+	setPresenceUsersFromJson(JsonVariantConst());
+	postEffectsLength(numberLeds);
+	postEffectsBrightness(gDefaultBrightness);
+	postEffectsGamma(gGamma);
+	postEffectsPixelType(gLedTypeRGBW);
 }
 
 // Save both system and effects settings into Preferences/NVS (unified config)
@@ -259,6 +451,9 @@ void saveAppConfig() {
 	sys["gamma"] = gGamma;
 	sys["led_type_rgbw"] = gLedTypeRGBW;  // Save LED type setting
 	sys["status_led_enabled"] = gStatusLedEnabled;  // Save status LED setting
+	sys["presence_layout"] = (gPresenceLayout == PRESENCE_LAYOUT_SEGMENTS) ? "segments" : "aggregate";
+	JsonArray users = sys["presence_users"].to<JsonArray>();
+	for (uint8_t i = 0; i < gPresenceUserCount; ++i) users.add(gPresenceUsers[i].id);
 	JsonObject eff = doc["effects"].to<JsonObject>();
 	JsonArray arr = eff["profiles"].to<JsonArray>();
 	for (size_t i = 0; i < (sizeof(gProfiles)/sizeof(gProfiles[0])); i++) {
@@ -314,14 +509,16 @@ void loadAppConfig() {
 		if (!sys["num_leds"].isNull()) {
 			numberLeds = (int)sys["num_leds"].as<int>();
 			if (numberLeds < 1) numberLeds = 1;
-			if (numberLeds > 1024) numberLeds = 1024;
-			effects.setLength(numberLeds);
+			if (numberLeds > LED_MAX_COUNT) numberLeds = LED_MAX_COUNT;
+			postEffectsLength(numberLeds);
 		}
 		if (!sys["fade_ms"].isNull()) gFadeDurationMs = (uint16_t)sys["fade_ms"].as<unsigned int>();
-		if (!sys["brightness"].isNull()) { gDefaultBrightness = (uint8_t)sys["brightness"].as<unsigned int>(); effects.setBrightness(gDefaultBrightness); }
-		if (!sys["gamma"].isNull()) { gGamma = sys["gamma"].as<float>(); if (isnan(gGamma) || gGamma < 0.1f) gGamma = 2.2f; if (gGamma > 5.0f) gGamma = 5.0f; effects.setGamma(gGamma); }
-		if (!sys["led_type_rgbw"].isNull()) { gLedTypeRGBW = sys["led_type_rgbw"].as<bool>(); effects.setPixelType(gLedTypeRGBW); }
+		if (!sys["brightness"].isNull()) { gDefaultBrightness = (uint8_t)sys["brightness"].as<unsigned int>(); postEffectsBrightness(gDefaultBrightness); }
+		if (!sys["gamma"].isNull()) { gGamma = sys["gamma"].as<float>(); if (isnan(gGamma) || gGamma < 0.1f) gGamma = 2.2f; if (gGamma > 5.0f) gGamma = 5.0f; postEffectsGamma(gGamma); }
+		if (!sys["led_type_rgbw"].isNull()) { gLedTypeRGBW = sys["led_type_rgbw"].as<bool>(); postEffectsPixelType(gLedTypeRGBW); }
 		if (!sys["status_led_enabled"].isNull()) { gStatusLedEnabled = sys["status_led_enabled"].as<bool>(); }
+		if (!sys["presence_layout"].isNull()) gPresenceLayout = parsePresenceLayout(sys["presence_layout"].as<String>());
+		if (!sys["presence_users"].isNull()) setPresenceUsersFromJson(sys["presence_users"]);
 	}
 	JsonObject eff = doc["effects"];
 	if (!eff.isNull() && eff["profiles"].is<JsonArray>()) {
@@ -351,19 +548,13 @@ void loadEffectsConfig() {
 	loadAppConfig();
 }
 
-// Fade transition state (single-phase fade-in by default)
+// Brightness ramp that runs alongside an effects crossfade (owned by the render task)
 struct FadeTransition {
 	bool active = false;
-	bool phaseOut = true;
 	uint8_t startBri = 0;
 	uint8_t endBri = 0;
 	unsigned long startMs = 0;
 	unsigned long durationMs = 0;
-	uint16_t pendingMode = FX_MODE_STATIC;
-	uint32_t pendingColor = BLACK;
-	uint16_t pendingSpeed = 3000;
-	bool pendingReverse = false;
-	uint8_t originalBri = 128;
 } gFade;
 
 // Track last requested target effect to avoid redundant restarts
@@ -376,8 +567,45 @@ struct TargetEffect {
 	uint8_t targetBri = 0;
 } gTarget;
 
-// Next transition's desired brightness (0=use global)
+// Commands posted to the render task; see applyEffectsCommand()
+enum EffectsCommandType : uint8_t {
+	EFFECTS_CMD_ANIMATION = 0,
+	EFFECTS_CMD_BRIGHTNESS = 1,
+	EFFECTS_CMD_GAMMA = 2,
+	EFFECTS_CMD_LENGTH = 3,
+	EFFECTS_CMD_PIXEL_TYPE = 4,
+	EFFECTS_CMD_OTA_BEGIN = 5,
+	EFFECTS_CMD_OTA_PROGRESS = 6,
+	EFFECTS_CMD_SEGMENT = 7,
+	EFFECTS_CMD_SEGMENT_CLEAR = 8
+};
+
+struct EffectsCommand {
+	EffectsCommandType type = EFFECTS_CMD_ANIMATION;
+	uint16_t mode = FX_MODE_STATIC;
+	uint32_t color = BLACK;
+	uint16_t speed = 3000;
+	bool reverse = false;
+	uint8_t bri = 0;          // ANIMATION/SEGMENT target brightness (SEGMENT: 0 = keep), BRIGHTNESS value
+	uint16_t fadeMs = 0;      // ANIMATION total transition time (0 = immediate)
+	uint16_t length = 0;      // ANIMATION/SEGMENT segment end, LENGTH value
+	uint16_t start = 0;       // SEGMENT range start
+	uint8_t segment = 0;      // SEGMENT, SEGMENT_CLEAR layer index
+	uint8_t blend = SEG_BLEND_REPLACE;
+	uint8_t opacity = 255;
+	float gamma = DEFAULT_GAMMA;
+	bool flag = false;        // PIXEL_TYPE: RGBW, OTA_PROGRESS: pixel on
+};
+
+// Next transition's desired brightness and fade time (0=use global)
 static uint8_t gNextTargetBri = 0;
+static uint16_t gNextFadeMs = 0;
+
+// Render-task copy of the brightness the current effect should settle at
+static bool gRenderTargetSet = false;
+static uint8_t gRenderTargetBri = 0;
+// Set while an OTA upload drives pixel 0 directly; effects rendering is paused
+static bool gOtaVisualsActive = false;
 
 void startFade(uint8_t from, uint8_t to, unsigned long dur) {
 	gFade.active = true;
@@ -392,27 +620,12 @@ void updateFade() {
 	unsigned long now = millis();
 	float t = (gFade.durationMs == 0) ? 1.0f : (float)(now - gFade.startMs) / (float)gFade.durationMs;
 	if (t >= 1.0f) t = 1.0f;
-	float tg = powf(t, gGamma);
+	float tg = powf(t, effects.getGamma());
 	if (tg < 0.0f) tg = 0.0f; if (tg > 1.0f) tg = 1.0f;
 	int delta = (int)gFade.endBri - (int)gFade.startBri;
 	uint8_t bri = (uint8_t)((int)gFade.startBri + (int)(delta * tg));
 	effects.setBrightness(bri);
-
-	if (t >= 1.0f) {
-		if (gFade.phaseOut) {
-			// Fade-out phase complete, switch to new effect and start fade-in
-			effects.setSegment(0, 0, numberLeds, gFade.pendingMode, gFade.pendingColor, gFade.pendingSpeed, gFade.pendingReverse);
-			effects.trigger();
-			gFade.phaseOut = false;
-			// Start fade-in phase (0 -> target brightness)
-			startFade(0, gFade.originalBri, gFade.durationMs);
-		} else {
-			// Fade-in phase complete, end transition
-			gFade.active = false;
-			gFade.phaseOut = true;
-			gFade.durationMs = 0;
-		}
-	}
+	if (t >= 1.0f) gFade.active = false;
 }
 
 // Global variables
@@ -490,6 +703,77 @@ static TaskHandle_t gWifiScanTask = nullptr;
 static uint8_t gDeviceLoginTransientFailures = 0;
 static const uint8_t DEVICE_LOGIN_TRANSIENT_FAILURE_LIMIT = 12;
 
+// HTTPS requests run on the network task so appTask keeps serving the web UI and
+// captive portal while Microsoft endpoints are slow. Results come back on
+// gNetResultQueue and are applied by appTask.
+enum NetJobType : uint8_t {
+	NET_JOB_DEVICE_CODE = 0,
+	NET_JOB_TOKEN_POLL = 1,
+	NET_JOB_PRESENCE = 2,
+	NET_JOB_TOKEN_REFRESH = 3,
+	NET_JOB_PRESENCE_BATCH = 4,
+	NET_JOB_TOKEN_REFRESH_BG = 5,  // refresh while presence polling continues
+	NET_JOB_SAVE_CONTEXT = 6,      // write `tokens` to NVS; no HTTP request
+	NET_JOB_DNS_PREFETCH = 7       // resolve the Microsoft hosts; no HTTP request
+};
+
+struct AuthTokens {
+	String access;
+	String refresh;
+	String id;
+};
+
+// URL and body are built in place inside the job, so a request costs one
+// allocation however long the refresh token is.
+struct NetJob {
+	NetJobType type = NET_JOB_PRESENCE;
+	RequestBuilder<NET_URL_CAPACITY> url;
+	RequestBuilder<NET_PAYLOAD_CAPACITY> payload;
+	const char* method = "POST";
+	String bearer;                        // snapshot of access_token, empty for none
+	const char* contentType = "application/x-www-form-urlencoded";
+	const JsonDocument* filter = nullptr;
+	JsonDocument response;                // written by the network task
+	bool ok = false;
+	AuthTokens tokens;                    // NET_JOB_SAVE_CONTEXT snapshot
+	uint32_t authGeneration = 0;
+};
+
+// Outcome of the last /api/startDevicelogin request, reported on the next poll
+struct DeviceLoginStartJob {
+	AsyncJobState state = ASYNC_JOB_IDLE;
+	int httpStatus = 0;
+	unsigned long completedAtMs = 0;
+	JsonDocument response;
+};
+
+static QueueHandle_t gNetRequestQueue = nullptr;
+static QueueHandle_t gNetResultQueue = nullptr;
+#define NET_QUEUE_DEPTH 5 // state-machine request, background refresh, context save, device-login start, DNS prefetch
+static bool gStatemachineJobPending = false; // token poll, presence or refresh in flight
+static bool gTokenRefreshPending = false;    // background refresh in flight
+static unsigned long gTokenRefreshAtMs = 0;  // when to start the next background refresh (0 = none)
+// Bumped by removeContext() and each device login so a queued save, an in-flight
+// refresh or a device-code start cannot resurrect or replace the current account
+static volatile uint32_t gAuthGeneration = 0;
+static DeviceLoginStartJob gDeviceLoginStartJob;
+
+// Hand a request to the network task; takes ownership of job
+static bool postNetJob(NetJob* job) {
+	const NetJobType type = job->type;
+	if (!gNetRequestQueue || xQueueSend(gNetRequestQueue, &job, 0) != pdTRUE) {
+		addLogf("Network job %u dropped (queue full)", (unsigned)type);
+		delete job;
+		return false;
+	}
+	if (type == NET_JOB_TOKEN_REFRESH_BG) {
+		gTokenRefreshPending = true;
+	} else if (type != NET_JOB_DEVICE_CODE && type != NET_JOB_SAVE_CONTEXT && type != NET_JOB_DNS_PREFETCH) {
+		gStatemachineJobPending = true;
+	}
+	return true;
+}
+
 static bool loadJsonPrefs(const char* key, JsonDocument& doc) {
 	Preferences prefs;
 	if (!prefs.begin(PREFS_NAMESPACE, true)) {
@@ -763,11 +1047,39 @@ bool isRequestAuthorized(const char* expectedKey) {
 
 static const char* kJsonMimeType = "application/json";
 
+// Print adapter that batches ArduinoJson's small writes into socket-sized pieces
+class WebResponseWriter : public Print {
+public:
+	explicit WebResponseWriter(WiFiClient& client) : _client(client) {}
+	~WebResponseWriter() { flush(); }
+
+	size_t write(uint8_t c) override {
+		if (_len == sizeof(_buf)) flush();
+		_buf[_len++] = c;
+		return 1;
+	}
+
+	size_t write(const uint8_t* data, size_t len) override {
+		for (size_t i = 0; i < len; ++i) write(data[i]);
+		return len;
+	}
+
+	void flush() override {
+		if (_len) _client.write(_buf, _len);
+		_len = 0;
+	}
+
+private:
+	WiFiClient& _client;
+	uint8_t _buf[WEB_RESPONSE_CHUNK];
+	size_t _len = 0;
+};
+
+// Serialized straight to the socket, so large documents never exist as one String
 static void sendJsonDocument(int statusCode, const JsonDocument& doc) {
-	String payload;
-	payload.reserve(measureJson(doc) + 1);
-	serializeJson(doc, payload);
-	server.send(statusCode, kJsonMimeType, payload);
+	server.sendHeaders(statusCode, kJsonMimeType, measureJson(doc));
+	WebResponseWriter out(server.client());
+	serializeJson(doc, out);
 }
 
 static void sendApiError(int statusCode, const char* error, const char* message = nullptr, const char* scope = nullptr) {
@@ -983,6 +1295,7 @@ static void processPendingSoftAPStop() {
 // Multicore
 TaskHandle_t TaskNeopixel;
 TaskHandle_t TaskApp;
+TaskHandle_t TaskNet;
 #if defined(CONFIG_IDF_TARGET_ESP32S3)
 #define LED_TASK_CORE 1
 #define APP_TASK_CORE 0
@@ -1100,10 +1413,10 @@ static void setStatusLedColor(uint32_t color) {
 }
 
 // Save auth context in Preferences/NVS
-void saveContext() {
-	bool accessOk = savePrefsBlobString(PREF_AUTH_ACCESS_TOKEN, access_token);
-	bool refreshOk = savePrefsBlobString(PREF_AUTH_REFRESH_TOKEN, refresh_token);
-	bool idOk = savePrefsBlobString(PREF_AUTH_ID_TOKEN, id_token);
+static void saveContextTokens(const AuthTokens& tokens) {
+	bool accessOk = savePrefsBlobString(PREF_AUTH_ACCESS_TOKEN, tokens.access);
+	bool refreshOk = savePrefsBlobString(PREF_AUTH_REFRESH_TOKEN, tokens.refresh);
+	bool idOk = savePrefsBlobString(PREF_AUTH_ID_TOKEN, tokens.id);
 	removePrefsKey(PREF_AUTH_CONTEXT); // Remove legacy combined payload once split keys are saved.
 
 	bool ok = accessOk && refreshOk && idOk;
@@ -1116,6 +1429,26 @@ void saveContext() {
 		idOk ? 1 : 0);
 }
 
+void saveContext() {
+	saveContextTokens({access_token, refresh_token, id_token});
+}
+
+// Persist the current tokens from the network task so the NVS write stays off appTask
+static void saveContextInBackground() {
+	NetJob* job = new NetJob();
+	job->type = NET_JOB_SAVE_CONTEXT;
+	job->tokens = {access_token, refresh_token, id_token};
+	job->authGeneration = gAuthGeneration;
+	postNetJob(job);
+}
+
+// Resolve the login and Graph hosts as soon as Wi-Fi is up, ahead of the first request
+static void prefetchMicrosoftHosts() {
+	NetJob* job = new NetJob();
+	job->type = NET_JOB_DNS_PREFETCH;
+	postNetJob(job);
+}
+
 boolean loadContext() {
 	boolean success = false;
 	String storedAccess;
@@ -1186,6 +1519,7 @@ boolean loadContext() {
 }
 
 void removeContext() {
+	gAuthGeneration++;
 	Preferences prefs;
 	if (prefs.begin(PREFS_NAMESPACE, false)) {
 		prefs.remove(PREF_AUTH_ACCESS_TOKEN);
@@ -1215,95 +1549,201 @@ bool startMDNS() {
 	return true;
 }
 
-// Synchronize time via NTP so TLS validation succeeds
-void syncTime() {
-	DBG_PRINTLN(F("syncTime() starting NTP"));
-    addLog("NTP sync start");
+// Wall-clock time for TLS certificate checks. SNTP runs in the background from
+// Wi-Fi connect and signals gTimeEvents; requests wait on that instead of polling.
+#define TIME_VALID_EPOCH 1609459200
+#define TIME_EVENT_VALID BIT0
+#define RTC_EPOCH_CHECK 0x53474C57u
+static EventGroupHandle_t gTimeEvents = nullptr;
+// Set once by whichever of appTask (Wi-Fi connect) or netTask (TLS request) starts SNTP first
+static std::atomic<bool> gSntpStarted{false};
+// RTC_NOINIT memory survives software resets and panics but not power loss
+RTC_NOINIT_ATTR static uint32_t gRtcEpoch;
+RTC_NOINIT_ATTR static uint32_t gRtcEpochCheck;
+
+static void onSntpTimeSync(struct timeval* tv) {
+	xEventGroupSetBits(gTimeEvents, TIME_EVENT_VALID);
+	DBG_PRINT(F("NTP time set: ")); DBG_PRINTLN((uint32_t)tv->tv_sec);
+	addLog("NTP time set");
+}
+
+void startTimeSync() {
+	if (gSntpStarted.exchange(true)) return;
+	sntp_set_time_sync_notification_cb(onSntpTimeSync);
 	configTime(0, 0, "pool.ntp.org", "time.nist.gov");
+	DBG_PRINTLN(F("startTimeSync() SNTP started"));
+	addLog("NTP sync start");
+}
+
+// Block the calling task until the clock is valid; returns false on timeout
+bool waitForTimeSync(uint32_t timeoutMs) {
+	if (time(nullptr) >= TIME_VALID_EPOCH) return true;
+	startTimeSync();
+	EventBits_t bits = xEventGroupWaitBits(gTimeEvents, TIME_EVENT_VALID, pdFALSE, pdTRUE, pdMS_TO_TICKS(timeoutMs));
+	if (bits & TIME_EVENT_VALID) return true;
+	DBG_PRINTLN(F("NTP time sync timed out; TLS may fail until time is set."));
+	addLog("NTP sync timeout");
+	return false;
+}
 
-	// Wait up to ~10 seconds for time to be set
-	time_t now = 0;
-	int retries = 0;
-	while (retries < 100) {
-		now = time(nullptr);
-		if (now > 1609459200) {
-			break;
-		}
-		vTaskDelay(100 / portTICK_PERIOD_MS);
-		retries++;
-	}
-	if (now > 1609459200) {
-		struct tm timeinfo;
-		gmtime_r(&now, &timeinfo);
-		DBG_PRINT(F("NTP time set: "));
-		DBG_PRINTLN(asctime(&timeinfo));
-        addLog("NTP time set");
-	} else {
-		DBG_PRINTLN(F("NTP time sync timed out; TLS may fail until time is set."));
-        addLog("NTP sync timeout");
+// Restore the clock saved before a warm reboot so TLS can validate certificates
+// before SNTP answers. The copy is a few seconds behind; SNTP corrects it.
+static void restoreRtcTime() {
+	gTimeEvents = xEventGroupCreate();
+	if (time(nullptr) >= TIME_VALID_EPOCH) {
+		xEventGroupSetBits(gTimeEvents, TIME_EVENT_VALID);
+		return;
 	}
+	if (esp_reset_reason() == ESP_RST_POWERON) return;
+	if (gRtcEpoch < TIME_VALID_EPOCH || (gRtcEpoch ^ RTC_EPOCH_CHECK) != gRtcEpochCheck) return;
+	struct timeval tv = { (time_t)gRtcEpoch, 0 };
+	settimeofday(&tv, nullptr);
+	xEventGroupSetBits(gTimeEvents, TIME_EVENT_VALID);
+	addLog("Clock restored from RTC memory");
+}
+
+// Keep the RTC copy of the clock current (called from appTask)
+static void updateRtcTime() {
+	const time_t now = time(nullptr);
+	if (now < TIME_VALID_EPOCH || (uint32_t)now == gRtcEpoch) return;
+	gRtcEpoch = (uint32_t)now;
+	gRtcEpochCheck = gRtcEpoch ^ RTC_EPOCH_CHECK;
 }
 
 #include "request_handler.h"
 
-static String normalizeAssetPath(String path) {
-	const int queryPos = path.indexOf('?');
-	if (queryPos >= 0) path.remove(queryPos);
-	if (path.length() == 0) path = "/";
-	if (path.endsWith("/")) path += "index.html";
-	return path;
-}
+#define ASSET_PATH_MAX 96 // longest request path looked up in the asset tables
 
-static const EmbeddedAsset* findEmbeddedAsset(const String& path) {
-	for (size_t i = 0; i < kEmbeddedAssetCount; ++i) {
-		if (path.equals(kEmbeddedAssets[i].path)) return &kEmbeddedAssets[i];
+// Drops the query and maps "/dir/" to "/dir/index.html" into buf, without
+// touching the heap; nullptr when the result does not fit
+static const char* normalizeAssetPath(const char* path, char* buf, size_t bufSize) {
+	size_t len = strcspn(path, "?");
+	if (len == 0) {
+		path = "/";
+		len = 1;
+	}
+	const bool directory = path[len - 1] == '/';
+	const size_t total = len + (directory ? strlen("index.html") : 0);
+	if (total >= bufSize) return nullptr;
+	memcpy(buf, path, len);
+	if (directory) memcpy(buf + len, "index.html", strlen("index.html"));
+	buf[total] = '\0';
+	return buf;
+}
+
+// Binary search over a route table sorted by strcmp(); hashed says which URL form matched
+static const EmbeddedAsset* findAssetIn(const EmbeddedAsset* assets, const EmbeddedAssetRoute* routes, size_t routeCount, const char* path, bool* hashed) {
+	size_t lo = 0, hi = routeCount;
+	while (lo < hi) {
+		const size_t mid = lo + (hi - lo) / 2;
+		const int cmp = strcmp(path, routes[mid].path);
+		if (cmp == 0) {
+			if (hashed) *hashed = routes[mid].hashed;
+			return &assets[routes[mid].asset];
+		}
+		if (cmp < 0) hi = mid; else lo = mid + 1;
 	}
 	return nullptr;
 }
 
-static bool clientAcceptsGzip() {
+// The flash bundle wins when one is mapped; the firmware's own copy is the fallback
+static const EmbeddedAsset* findEmbeddedAsset(const char* path, bool* hashed = nullptr) {
+	if (!path) return nullptr;
+	if (gUiBundle.active()) {
+		const EmbeddedAsset* asset = findAssetIn(gUiBundle.assets(), gUiBundle.routes(), gUiBundle.routeCount(), path, hashed);
+		if (asset) return asset;
+	}
+	return findAssetIn(kEmbeddedAssets, kEmbeddedAssetRoutes, kEmbeddedAssetRouteCount, path, hashed);
+}
+
+// True when Accept-Encoding lists coding without "q=0"
+static bool clientAcceptsEncoding(const char* coding) {
 	String acceptEncoding = server.header("Accept-Encoding");
 	acceptEncoding.toLowerCase();
-	return acceptEncoding.indexOf("gzip") >= 0;
+	const size_t codingLen = strlen(coding);
+	int start = 0;
+	while (start < (int)acceptEncoding.length()) {
+		int end = acceptEncoding.indexOf(',', start);
+		if (end < 0) end = acceptEncoding.length();
+		String token = acceptEncoding.substring(start, end);
+		token.trim();
+		start = end + 1;
+		if (!token.startsWith(coding)) continue;
+		const char next = token.length() > codingLen ? token.charAt(codingLen) : '\0';
+		if (next != '\0' && next != ';' && next != ' ') continue; // e.g. "gzip" inside "x-gzip2"
+		const int q = token.indexOf("q=");
+		return q < 0 || token.substring(q + 2).toFloat() > 0.0f;
+	}
+	return false;
 }
 
 static bool isHtmlContentType(const char* contentType) {
 	return contentType && strncmp(contentType, "text/html", 9) == 0;
 }
 
-static void serveEmbeddedAsset(const EmbeddedAsset& asset) {
+static bool clientHasEtag(const char* etag) {
+	const String ifNoneMatch = server.header("If-None-Match");
+	return ifNoneMatch.length() && (ifNoneMatch == "*" || ifNoneMatch.indexOf(etag) >= 0);
+}
+
+// Hashed URLs never change content, so browsers may keep them for good. Plain
+// URLs and pages are revalidated on every use against the build-time ETag,
+// which costs a 304 with no body when nothing changed, e.g. after an OTA.
+static void serveEmbeddedAsset(const EmbeddedAsset& asset, bool hashedUrl = false) {
 	const uint8_t* payload = asset.rawData;
 	size_t payloadLength = asset.rawLength;
-	const bool serveGzip = asset.gzipData && asset.gzipLength > 0 && clientAcceptsGzip();
-	if (serveGzip) {
+	const char* etag = asset.etag;
+	const char* contentEncoding = nullptr;
+	const bool hasGzip = asset.gzipData && asset.gzipLength > 0;
+	const bool hasBrotli = asset.brData && asset.brLength > 0;
+	if (hasGzip || hasBrotli) {
+		server.sendHeader("Vary", "Accept-Encoding");
+	}
+	// br > gzip > identity; without an identity copy (EMBED_ASSETS_COMPRESSED_ONLY) gzip is the fallback
+	if (hasBrotli && clientAcceptsEncoding("br")) {
+		payload = asset.brData;
+		payloadLength = asset.brLength;
+		etag = asset.brEtag;
+		contentEncoding = "br";
+	} else if (hasGzip && (!asset.rawData || clientAcceptsEncoding("gzip"))) {
 		payload = asset.gzipData;
 		payloadLength = asset.gzipLength;
-		server.sendHeader("Content-Encoding", "gzip");
-		server.sendHeader("Vary", "Accept-Encoding");
+		etag = asset.gzipEtag;
+		contentEncoding = "gzip";
 	}
-	if (isHtmlContentType(asset.contentType)) {
-		server.sendHeader("Cache-Control", "no-store, no-cache, must-revalidate, max-age=0");
-		server.sendHeader("Pragma", "no-cache");
-		server.sendHeader("Expires", "0");
+	if (hashedUrl) {
+		server.sendHeader("Cache-Control", "public, max-age=31536000, immutable");
+	} else if (isHtmlContentType(asset.contentType)) {
+		server.sendHeader("Cache-Control", "private, no-cache"); // pages may sit behind the admin key
 	} else {
-		server.sendHeader("Cache-Control", "public, max-age=86400");
+		server.sendHeader("Cache-Control", "no-cache");
+	}
+	server.sendHeader("ETag", etag);
+	if (clientHasEtag(etag)) {
+		server.send(304);
+		return;
+	}
+	if (contentEncoding) {
+		server.sendHeader("Content-Encoding", contentEncoding);
 	}
 	server.send_P(200, asset.contentType, reinterpret_cast<PGM_P>(payload), payloadLength);
 }
 
-static bool serveEmbeddedAssetPath(String path) {
-	const EmbeddedAsset* asset = findEmbeddedAsset(normalizeAssetPath(path));
+static bool serveEmbeddedAssetPath(const char* path) {
+	char buf[ASSET_PATH_MAX];
+	bool hashed = false;
+	const EmbeddedAsset* asset = findEmbeddedAsset(normalizeAssetPath(path, buf, sizeof(buf)), &hashed);
 	if (!asset) return false;
-	serveEmbeddedAsset(*asset);
+	serveEmbeddedAsset(*asset, hashed);
 	return true;
 }
 
 static void serveEmbeddedPageOr500(const char* path) {
-	if (!serveEmbeddedAssetPath(String(path))) {
+	if (!serveEmbeddedAssetPath(path)) {
 		server.send(
 			500,
 			"text/html; charset=utf-8",
-			F("<!DOCTYPE html><html><head><meta charset='utf-8'><meta name='viewport' content='width=device-width,initial-scale=1'><title>StatusGlow UI Missing</title></head><body style='font-family:system-ui,-apple-system,Segoe UI,Roboto,Arial,sans-serif;padding:24px;line-height:1.5'><h1>StatusGlow UI assets are missing</h1><p>The firmware is running, but the embedded web UI asset registry did not contain the requested page.</p></body></html>")
+			F("<!DOCTYPE html><html><head><meta charset='utf-8'><meta name='viewport' content='width=device-width,initial-scale=1'><title>StatusGlow UI Missing</title></head><body style='font-family:system-ui,-apple-system,Segoe UI,Roboto,Arial,sans-serif;padding:24px;line-height:1.5'><h1>StatusGlow UI assets are missing</h1><p>The firmware is running, but neither the UI bundle partition nor the embedded web UI asset registry contained the requested page.</p><p>Upload a <code>ui_bundle.bin</code> at <a href='/update_ui'>/update_ui</a>.</p></body></html>")
 		);
 	}
 }
@@ -1313,13 +1753,14 @@ static void serveSetupPortalPage() {
 }
 
 static void serveEmbeddedAssetOr404(const char* path) {
-	if (!serveEmbeddedAssetPath(String(path))) {
+	if (!serveEmbeddedAssetPath(path)) {
 		server.send(404, "text/plain", "FileNotFound");
 	}
 }
 
-static bool isAllowedPublicAssetPath(String path) {
-	const EmbeddedAsset* asset = findEmbeddedAsset(normalizeAssetPath(path));
+static bool isAllowedPublicAssetPath(const char* path) {
+	char buf[ASSET_PATH_MAX];
+	const EmbeddedAsset* asset = findEmbeddedAsset(normalizeAssetPath(path, buf, sizeof(buf)));
 	return asset && asset->publicAsset;
 }
 
@@ -1506,14 +1947,19 @@ static void serveNoContent() {
 	server.send(204);
 }
 
+static void postEffectsCommand(const EffectsCommand& cmd);
+
 static void beginOtaVisuals() {
-	EFFECTS_LOCK();
-	effects.setBrightness(200);
-	effects.setSegment(0, 0, numberLeds, FX_MODE_STATIC, BLACK, 0, false);
-	effects.strip.clear();
-	effects.strip.setPixelColor(0, effects.Color(255, 255, 255));
-	effects.strip.show();
-	EFFECTS_UNLOCK();
+	EffectsCommand cmd;
+	cmd.type = EFFECTS_CMD_OTA_BEGIN;
+	postEffectsCommand(cmd);
+}
+
+static void showOtaProgressPixel(bool on) {
+	EffectsCommand cmd;
+	cmd.type = EFFECTS_CMD_OTA_PROGRESS;
+	cmd.flag = on;
+	postEffectsCommand(cmd);
 }
 
 static String buildOtaUploadPage(const char* actionPath, const char* inputName, const char* title) {
@@ -1610,7 +2056,6 @@ static void playStartupSequence() {
 	const unsigned long totalMs = STARTUP_SEQUENCE_MS;
 	const unsigned long startMs = millis();
 
-	EFFECTS_LOCK();
 	while ((millis() - startMs) < totalMs) {
 		float t = (float)(millis() - startMs) / (float)totalMs;
 		if (t < 0.64f) {
@@ -1626,129 +2071,269 @@ static void playStartupSequence() {
 	}
 	effects.strip.clear();
 	effects.strip.show();
-	EFFECTS_UNLOCK();
+	effects.invalidateFrame();
+}
+
+// The engine crossfades old and new effects; brightness ramps to the new target alongside
+static void setRenderTargetBri(uint8_t bri, uint16_t fadeMs) {
+	gRenderTargetSet = true;
+	gRenderTargetBri = bri;
+	if (fadeMs > 0 && effects.getBrightness() != bri) {
+		startFade(effects.getBrightness(), bri, fadeMs);
+	} else {
+		gFade.active = false;
+		effects.setBrightness(bri);
+	}
+}
+
+// Apply a command on the render task (or directly during setup(), before it starts)
+static void applyEffectsCommand(const EffectsCommand& cmd) {
+	switch (cmd.type) {
+		case EFFECTS_CMD_ANIMATION:
+			gOtaVisualsActive = false;
+			setRenderTargetBri(cmd.bri, cmd.fadeMs);
+			effects.setTransitionMs(cmd.fadeMs);
+			effects.setBaseEffect(cmd.length, cmd.mode, cmd.color, cmd.speed, cmd.reverse);
+			effects.trigger();
+			break;
+		case EFFECTS_CMD_SEGMENT:
+			if (cmd.bri != 0) setRenderTargetBri(cmd.bri, cmd.fadeMs);
+			effects.setSegmentBlend(cmd.segment, (SegmentBlend)cmd.blend, cmd.opacity);
+			effects.setTransitionMs(cmd.fadeMs);
+			effects.setSegment(cmd.segment, cmd.start, cmd.length, cmd.mode, cmd.color, cmd.speed, cmd.reverse);
+			break;
+		case EFFECTS_CMD_SEGMENT_CLEAR:
+			effects.clearSegment(cmd.segment);
+			break;
+		case EFFECTS_CMD_BRIGHTNESS:
+			effects.setBrightness(cmd.bri);
+			break;
+		case EFFECTS_CMD_GAMMA:
+			effects.setGamma(cmd.gamma);
+			break;
+		case EFFECTS_CMD_LENGTH:
+			effects.setLength(cmd.length);
+			break;
+		case EFFECTS_CMD_PIXEL_TYPE:
+			effects.setPixelType(cmd.flag);
+			break;
+		case EFFECTS_CMD_OTA_BEGIN:
+			gOtaVisualsActive = true;
+			gFade.active = false;
+			effects.strip.clear();
+			effects.strip.setPixelColor(0, effects.Color(255, 255, 255));
+			effects.strip.show();
+			effects.invalidateFrame();
+			break;
+		case EFFECTS_CMD_OTA_PROGRESS:
+			if (!gOtaVisualsActive) break;
+			effects.strip.setPixelColor(0, cmd.flag ? effects.Color(255, 255, 255) : effects.Color(0, 0, 0));
+			effects.strip.show();
+			break;
+	}
+}
+
+// Hand a command to the render task without touching the engine from this task
+static void postEffectsCommand(const EffectsCommand& cmd) {
+	if (!gEffectsQueue || !TaskNeopixel) {
+		applyEffectsCommand(cmd);
+		return;
+	}
+	// Never wait here: callers are HTTP handlers and the state machine on appTask
+	if (xQueueSend(gEffectsQueue, &cmd, 0) != pdTRUE) {
+		addLogf("Effects command %u dropped (render queue full)", (unsigned)cmd.type);
+		return;
+	}
+	// Wake the render task now instead of at its next frame deadline
+	xTaskNotifyGive(TaskNeopixel);
+}
+
+static void postEffectsBrightness(uint8_t bri) {
+	EffectsCommand cmd;
+	cmd.type = EFFECTS_CMD_BRIGHTNESS;
+	cmd.bri = bri;
+	postEffectsCommand(cmd);
+}
+
+static void postEffectsGamma(float gamma) {
+	EffectsCommand cmd;
+	cmd.type = EFFECTS_CMD_GAMMA;
+	cmd.gamma = gamma;
+	postEffectsCommand(cmd);
+}
+
+static void postEffectsLength(uint16_t length) {
+	EffectsCommand cmd;
+	cmd.type = EFFECTS_CMD_LENGTH;
+	cmd.length = length;
+	postEffectsCommand(cmd);
+}
+
+static void postEffectsPixelType(bool isRGBW) {
+	EffectsCommand cmd;
+	cmd.type = EFFECTS_CMD_PIXEL_TYPE;
+	cmd.flag = isRGBW;
+	postEffectsCommand(cmd);
+}
+
+// Leave the segments layout: drop the per-user slices above the base layer
+static void clearPresenceSegments() {
+	for (uint8_t i = 1; i < gPresenceSegmentsShown; ++i) {
+		EffectsCommand cmd;
+		cmd.type = EFFECTS_CMD_SEGMENT_CLEAR;
+		cmd.segment = i;
+		postEffectsCommand(cmd);
+	}
+	for (uint8_t i = 0; i < PRESENCE_MAX_USERS; ++i) gPresenceUsers[i].shownActivity = "";
+	gPresenceSegmentsShown = 0;
+	gPresenceSegmentsBri = 0;
 }
 
 // Neopixel control
 void setAnimation(uint8_t segment, uint8_t mode = FX_MODE_STATIC, uint32_t color = RED, uint16_t speed = 3000, bool reverse = false) {
-	uint16_t startLed = 0, endLed = 0;
+	uint16_t endLed = 0;
 	if (segment == 0) {
-		startLed = 0;
 		endLed = numberLeds;
 	}
+	if (gPresenceSegmentsShown > 0) clearPresenceSegments();
 	DBG_PRINT("setAnimation ");
-	DBG_PRINT(segment); DBG_PRINT(": "); DBG_PRINT(startLed); DBG_PRINT("-"); DBG_PRINT(endLed); DBG_PRINT(" M:"); DBG_PRINT(mode); DBG_PRINT(" C:"); DBG_PRINT((unsigned int)color); DBG_PRINT(" S:"); DBG_PRINTLN((unsigned int)speed);
-			uint8_t targetBri = (gNextTargetBri != 0) ? gNextTargetBri : gDefaultBrightness;
-			gNextTargetBri = 0;
-			
-			EFFECTS_LOCK();
-			
-			// Check if we're already showing this exact animation
-			if (gTarget.initialized) {
-				bool sameTarget = (gTarget.mode == mode) && (gTarget.color == color) &&
-				                  (gTarget.speed == speed) && (gTarget.reverse == reverse) &&
-				                  (gTarget.targetBri == targetBri);
-				if (sameTarget && !gFade.active) {
-					// Already at target and not fading, nothing to do
-					EFFECTS_UNLOCK();
-					return;
-				}
-				
-				// Check if we're already fading to this exact animation
-				if (gFade.active && gFade.phaseOut) {
-					bool samePending = (gFade.pendingMode == mode) && (gFade.pendingColor == color) &&
-					                   (gFade.pendingSpeed == speed) && (gFade.pendingReverse == reverse) &&
-					                   (gFade.originalBri == targetBri);
-					if (samePending) {
-						// Already fading to this target, don't interrupt
-						EFFECTS_UNLOCK();
-						return;
-					}
-				}
-			}
-			
-			// Update gTarget inside the lock to prevent race conditions
-			gTarget.initialized = true;
-			gTarget.mode = mode;
-			gTarget.color = color;
-			gTarget.speed = speed;
-			gTarget.reverse = reverse;
-			gTarget.targetBri = targetBri;
-			
-			if (gFadeDurationMs > 0) {
-				// Two-phase transition: fade out current effect, then fade in new effect
-				gFade.originalBri = targetBri;
-				gFade.pendingMode = mode;
-				gFade.pendingColor = color;
-				gFade.pendingSpeed = speed;
-				gFade.pendingReverse = reverse;
-				gFade.phaseOut = true;
-				// Start fade-out phase (current brightness -> 0)
-				uint8_t currentBri = effects.getBrightness();
-				startFade(currentBri, 0, (gFade.durationMs == 0 ? gFadeDurationMs : gFade.durationMs) / 2);
-			} else {
-				// No fade, immediate transition
-				effects.setBrightness(targetBri);
-				effects.setSegment(segment, startLed, endLed, mode, color, speed, reverse);
-				effects.trigger();
-			}
-			EFFECTS_UNLOCK();
+	DBG_PRINT(segment); DBG_PRINT(": 0-"); DBG_PRINT(endLed); DBG_PRINT(" M:"); DBG_PRINT(mode); DBG_PRINT(" C:"); DBG_PRINT((unsigned int)color); DBG_PRINT(" S:"); DBG_PRINTLN((unsigned int)speed);
+	uint8_t targetBri = (gNextTargetBri != 0) ? gNextTargetBri : gDefaultBrightness;
+	uint16_t fadeMs = (gNextFadeMs != 0) ? gNextFadeMs : gFadeDurationMs;
+	gNextTargetBri = 0;
+	gNextFadeMs = 0;
+
+	// Already showing (or fading to) this exact animation
+	if (gTarget.initialized) {
+		bool sameTarget = (gTarget.mode == mode) && (gTarget.color == color) &&
+		                  (gTarget.speed == speed) && (gTarget.reverse == reverse) &&
+		                  (gTarget.targetBri == targetBri);
+		if (sameTarget) return;
+	}
+
+	gTarget.initialized = true;
+	gTarget.mode = mode;
+	gTarget.color = color;
+	gTarget.speed = speed;
+	gTarget.reverse = reverse;
+	gTarget.targetBri = targetBri;
+
+	EffectsCommand cmd;
+	cmd.type = EFFECTS_CMD_ANIMATION;
+	cmd.mode = mode;
+	cmd.color = color;
+	cmd.speed = speed;
+	cmd.reverse = reverse;
+	cmd.bri = targetBri;
+	cmd.fadeMs = (gFadeDurationMs > 0) ? fadeMs : 0;
+	cmd.length = endLed;
+	postEffectsCommand(cmd);
+}
+
+// Effect for one presence activity: its profile, or the built-in fallback
+static EffectProfile resolvePresenceProfile(const String& act) {
+	EffectProfile* p = findProfile(act);
+	if (p != nullptr) {
+		EffectProfile out = *p;
+		if (out.bri == 0) out.bri = gDefaultBrightness;
+		return out;
+	}
+	EffectProfile out = {"", BLACK, FX_MODE_STATIC, 3000, false, 0, gDefaultBrightness};
+	if (act.equals("Inactive")) {
+		out.mode = FX_MODE_STATIC; out.color = BLACK;
+	} else if (act.equals("Presenting")) {
+		out.mode = FX_MODE_RUNNING_LIGHTS; out.color = RED; out.speed = 5200;
+	} else if (act.equals("InAMeeting")) {
+		out.mode = FX_MODE_COMET; out.color = RED; out.speed = 4200;
+	} else if (act.equals("InAConferenceCall")) {
+		out.mode = FX_MODE_RUNNING_LIGHTS; out.color = RED; out.speed = 4600;
+	} else if (act.equals("InACall")) {
+		out.mode = FX_MODE_DUAL_SCAN; out.color = RED; out.speed = 3800;
+	} else if (act.equals("Offline") || act.equals("OffWork") || act.equals("OutOfOffice") || act.equals("PresenceUnknown")) {
+		out.mode = FX_MODE_STATIC; out.color = BLACK;
+	} else if (act.equals("DoNotDisturb") || act.equals("UrgentInterruptionsOnly")) {
+		out.mode = FX_MODE_BREATH; out.color = PINK; out.speed = act.equals("UrgentInterruptionsOnly") ? 1400 : 1900;
+	} else if (act.equals("Busy")) {
+		out.mode = FX_MODE_BREATH; out.color = PURPLE; out.speed = 2600;
+	} else if (act.equals("BeRightBack")) {
+		out.mode = FX_MODE_BREATH; out.color = ORANGE; out.speed = 3200;
+	} else if (act.equals("Away")) {
+		out.mode = FX_MODE_BREATH; out.color = YELLOW; out.speed = 4800;
+	} else if (act.equals("Available")) {
+		out.mode = FX_MODE_STATIC; out.color = GREEN;
+	}
+	return out;
+}
+
+// Segments layout: user i gets an equal slice of the strip on engine segment i,
+// so only the first LED_EFFECTS_MAX_SEGMENTS of the PRESENCE_MAX_USERS users are
+// shown. The layout owns every engine layer while it is active (/api/segment is
+// refused), and entering it drops any overlays left on the upper layers.
+// The strip runs at the brightest user's profile brightness and dimmer users'
+// slices are mixed down by opacity; gamma(a)/gamma(b) == gamma(a/b), so each
+// slice ends up at its own profile brightness.
+// Only slices whose activity changed are re-sent, since setSegment() restarts the crossfade.
+static void applyPresenceSegments() {
+	const uint8_t count = min<uint8_t>(gPresenceUserCount, LED_EFFECTS_MAX_SEGMENTS);
+	EffectProfile profiles[LED_EFFECTS_MAX_SEGMENTS];
+	uint8_t stripBri = 0;
+	for (uint8_t i = 0; i < count; ++i) {
+		profiles[i] = resolvePresenceProfile(gPresenceUsers[i].activity);
+		stripBri = max(stripBri, profiles[i].bri);
+	}
+	const bool entering = (gPresenceSegmentsShown == 0);
+	const bool relayout = (count != gPresenceSegmentsShown) || (gPresenceSegmentsLeds != numberLeds) ||
+	                      (stripBri != gPresenceSegmentsBri);
+	const float gamma = gGamma > 0.101f ? gGamma : 1.0f; // the engine treats tiny gammas as linear
+	gTarget.initialized = false; // segment 0 no longer shows the single-user target
+	for (uint8_t i = 0; i < count; ++i) {
+		PresenceUser& u = gPresenceUsers[i];
+		if (!relayout && u.shownActivity == u.activity) continue;
+		const EffectProfile& p = profiles[i];
+		EffectsCommand cmd;
+		cmd.type = EFFECTS_CMD_SEGMENT;
+		cmd.segment = i;
+		cmd.start = (uint16_t)((uint32_t)numberLeds * i / count);
+		cmd.length = (uint16_t)((uint32_t)numberLeds * (i + 1) / count);
+		cmd.mode = p.mode;
+		cmd.color = p.color;
+		cmd.speed = p.speed;
+		cmd.reverse = p.reverse;
+		cmd.fadeMs = (gFadeDurationMs > 0) ? (p.fadeMs ? p.fadeMs : gFadeDurationMs) : 0;
+		cmd.bri = stripBri;
+		if (stripBri > 0 && p.bri < stripBri) {
+			cmd.blend = SEG_BLEND_ALPHA;
+			cmd.opacity = (uint8_t)(powf((float)p.bri / (float)stripBri, gamma) * 255.0f + 0.5f);
+		}
+		postEffectsCommand(cmd);
+		u.shownActivity = u.activity;
+	}
+	const uint8_t clearTo = entering ? LED_EFFECTS_MAX_SEGMENTS : gPresenceSegmentsShown;
+	for (uint8_t i = count; i < clearTo; ++i) {
+		EffectsCommand cmd;
+		cmd.type = EFFECTS_CMD_SEGMENT_CLEAR;
+		cmd.segment = i;
+		postEffectsCommand(cmd);
+	}
+	gPresenceSegmentsShown = count;
+	gPresenceSegmentsLeds = numberLeds;
+	gPresenceSegmentsBri = stripBri;
 }
 
 void setPresenceAnimation() {
 	if (gPreviewMode) return;
-	uint16_t tMode = FX_MODE_STATIC;
-	uint32_t tColor = BLACK;
-	uint16_t tSpeed = 3000;
-	bool tReverse = false;
-	uint16_t perFade = 0;
-	uint8_t perBri = gDefaultBrightness;
-	EffectProfile* p = findProfile(activity);
-	if (p != nullptr) {
-		tMode = p->mode;
-		tColor = p->color;
-		tSpeed = p->speed;
-		tReverse = p->reverse;
-		perFade = p->fadeMs;
-		perBri = (p->bri != 0) ? p->bri : gDefaultBrightness;
-	} else {
-	if (activity.equals("Inactive")) {
-	    tMode = FX_MODE_STATIC; tColor = BLACK;
-	} else if (activity.equals("Presenting")) {
-			tMode = FX_MODE_RUNNING_LIGHTS; tColor = RED; tSpeed = 5200;
-		} else if (activity.equals("InAMeeting")) {
-			tMode = FX_MODE_COMET; tColor = RED; tSpeed = 4200;
-		} else if (activity.equals("InAConferenceCall")) {
-			tMode = FX_MODE_RUNNING_LIGHTS; tColor = RED; tSpeed = 4600;
-		} else if (activity.equals("InACall")) {
-			tMode = FX_MODE_DUAL_SCAN; tColor = RED; tSpeed = 3800;
-		} else if (activity.equals("Offline") || activity.equals("OffWork") || activity.equals("OutOfOffice") || activity.equals("PresenceUnknown")) {
-			tMode = FX_MODE_STATIC; tColor = BLACK;
-		} else if (activity.equals("DoNotDisturb") || activity.equals("UrgentInterruptionsOnly")) {
-			tMode = FX_MODE_BREATH; tColor = PINK; tSpeed = activity.equals("UrgentInterruptionsOnly") ? 1400 : 1900;
-		} else if (activity.equals("Busy")) {
-			tMode = FX_MODE_BREATH; tColor = PURPLE; tSpeed = 2600;
-		} else if (activity.equals("BeRightBack")) {
-			tMode = FX_MODE_BREATH; tColor = ORANGE; tSpeed = 3200;
-		} else if (activity.equals("Away")) {
-			tMode = FX_MODE_BREATH; tColor = YELLOW; tSpeed = 4800;
-		} else if (activity.equals("Available")) {
-			tMode = FX_MODE_STATIC; tColor = GREEN;
-		}
+	if (gPresenceUserCount > 0 && gPresenceLayout == PRESENCE_LAYOUT_SEGMENTS) {
+		applyPresenceSegments();
+		return;
 	}
+	EffectProfile p = resolvePresenceProfile(activity);
 	if (gTarget.initialized) {
-		bool sameTarget = (gTarget.mode == tMode) && (gTarget.color == tColor) && (gTarget.speed == tSpeed) && (gTarget.reverse == tReverse) && (gTarget.targetBri == perBri);
+		bool sameTarget = (gTarget.mode == p.mode) && (gTarget.color == p.color) && (gTarget.speed == p.speed) && (gTarget.reverse == p.reverse) && (gTarget.targetBri == p.bri);
 		if (sameTarget) return;
-		if (gFade.active && gFade.phaseOut) {
-			bool samePending = (gFade.pendingMode == tMode) && (gFade.pendingColor == tColor) && (gFade.pendingSpeed == tSpeed) && (gFade.pendingReverse == tReverse) && (gFade.originalBri == perBri);
-			if (samePending) return;
-		}
 	}
-	EFFECTS_LOCK();
-	gFade.durationMs = perFade;
-	gNextTargetBri = perBri;
-	EFFECTS_UNLOCK();
-	setAnimation(0, tMode, tColor, tSpeed, tReverse);
+	gNextFadeMs = p.fadeMs;
+	gNextTargetBri = p.bri;
+	setAnimation(0, p.mode, p.color, p.speed, p.reverse);
 }
 
 // Apply the current preview selection if preview mode is active
@@ -1762,10 +2347,8 @@ void applyPreviewSelection() {
 	bool tReverse = p->reverse;
 	uint16_t perFade = p->fadeMs;
 	uint8_t perBri = (p->bri != 0) ? p->bri : gDefaultBrightness;
-	EFFECTS_LOCK();
-	gFade.durationMs = perFade;
+	gNextFadeMs = perFade;
 	gNextTargetBri = perBri;
-	EFFECTS_UNLOCK();
 	setAnimation(0, tMode, tColor, tSpeed, tReverse);
 }
 
@@ -1774,21 +2357,21 @@ void onWifiConnected() { state = SMODEWIFICONNECTED; }
 
 // Poll for access token during device login flow
 void pollForToken() {
-	if (time(nullptr) < 1609459200) {
-		syncTime();
-	}
-	String payload;
-	String encodedClientId = urlEncodeFormValue(String(paramClientIdValue));
-	String encodedDeviceCode = urlEncodeFormValue(device_code);
-	payload.reserve(encodedClientId.length() + encodedDeviceCode.length() + 96);
-	payload += F("client_id=");
-	payload += encodedClientId;
-	payload += F("&grant_type=urn:ietf:params:oauth:grant-type:device_code&device_code=");
-	payload += encodedDeviceCode;
+	NetJob* job = new NetJob();
+	job->type = NET_JOB_TOKEN_POLL;
+	job->url.append(LOGIN_BASE_URL "/").append(paramTenantValue).append("/oauth2/v2.0/token");
+	job->payload.formField("client_id", paramClientIdValue);
+	job->payload.formField("grant_type", "urn:ietf:params:oauth:grant-type:device_code");
+	job->payload.formField("device_code", device_code);
+	job->filter = &tokenResponseFilter();
 	DBG_PRINTLN("pollForToken()");
-	JsonDocument responseDoc;
-	boolean res = requestJsonApi(responseDoc, "https://login.microsoftonline.com/" + String(paramTenantValue) + "/oauth2/v2.0/token", payload, 0);
-	if (!res) {
+	postNetJob(job);
+}
+
+static void handleTokenPollResult(NetJob& job) {
+	if (state != SMODEDEVICELOGINSTARTED) return; // login was reset while the request ran
+	JsonDocument& responseDoc = job.response;
+	if (!job.ok) {
 		gDeviceLoginTransientFailures++;
 		addLogf("Device login poll transient failure %u/%u", gDeviceLoginTransientFailures, DEVICE_LOGIN_TRANSIENT_FAILURE_LIMIT);
 		if (gDeviceLoginTransientFailures >= DEVICE_LOGIN_TRANSIENT_FAILURE_LIMIT) {
@@ -1816,21 +2399,134 @@ void pollForToken() {
 			unsigned int _expires_in = responseDoc["expires_in"].as<unsigned int>();
 			// Calculate timestamp when token expires
 			expires = millis() + (_expires_in * 1000);
+			scheduleTokenRefresh(_expires_in);
+			// A new account: refreshes still running for the old one must not land
+			gAuthGeneration++;
 
 			// Set state
 			state = SMODEAUTHREADY;
 		} else {
-			DBG_PRINT("pollForToken() - Unknown response: "); DBG_PRINTLN(responseDoc.as<const char*>());
+			DBG_PRINT("pollForToken() - Unknown response: "); DBG_PRINTLN(responseDoc.as<String>());
 		}
 	}
 }
 
+// Adaptive presence polling. Each poll picks the next interval: the minimum for a
+// window after availability/activity changed, otherwise double the last one up to
+// the configured interval (the idle cap while Offline). Retry-After always wins.
+#define PRESENCE_POLL_HISTOGRAM_BUCKETS 9 // <=5, <=10, ... <=640 s, longer
+struct PresencePollSchedule {
+	uint32_t intervalS = 0;
+	unsigned long fastUntilMs = 0;
+	uint32_t histogram[PRESENCE_POLL_HISTOGRAM_BUCKETS] = {0};
+};
+static PresencePollSchedule gPresencePoll;
+
+static uint32_t schedulePresencePoll(bool changed, uint32_t retryAfterS) {
+	const uint32_t minS = min<uint32_t>(PRESENCE_POLL_MIN_SECONDS, getPollIntervalSeconds());
+	const bool idle = availability == "Offline" || availability == "PresenceUnknown";
+	const uint32_t maxS = idle ? max<uint32_t>(PRESENCE_POLL_IDLE_MAX_SECONDS, getPollIntervalSeconds()) : getPollIntervalSeconds();
+	if (changed) {
+		gPresencePoll.fastUntilMs = millis() + (PRESENCE_POLL_FAST_WINDOW_S * 1000UL);
+		gPresencePoll.intervalS = minS;
+	} else if ((long)(gPresencePoll.fastUntilMs - millis()) > 0) {
+		gPresencePoll.intervalS = minS;
+	} else {
+		gPresencePoll.intervalS = constrain(gPresencePoll.intervalS * 2, minS, maxS);
+	}
+	uint32_t nextS = max<uint32_t>(gPresencePoll.intervalS, retryAfterS);
+	uint8_t bucket = 0;
+	while (bucket < PRESENCE_POLL_HISTOGRAM_BUCKETS - 1 && nextS > (5UL << bucket)) bucket++;
+	gPresencePoll.histogram[bucket]++;
+	return nextS;
+}
+
+void fillPresencePollJson(JsonDocument& doc) {
+	doc["poll_interval_current"] = gPresencePoll.intervalS ? gPresencePoll.intervalS : getPollIntervalSeconds();
+	JsonObject hist = doc["poll_histogram"].to<JsonObject>();
+	for (uint8_t i = 0; i < PRESENCE_POLL_HISTOGRAM_BUCKETS; ++i) {
+		const String key = (i < PRESENCE_POLL_HISTOGRAM_BUCKETS - 1) ? String(5UL << i) : String("inf");
+		hist[key] = gPresencePoll.histogram[i];
+	}
+}
+
 // Get presence information from Microsoft Graph
 void pollPresence() {
-	JsonDocument responseDoc;
-	boolean res = requestJsonApi(responseDoc, "https://graph.microsoft.com/v1.0/me/presence", "", 0, "GET", true);
+	NetJob* job = new NetJob();
+	job->bearer = access_token;
+	if (gPresenceUserCount == 0) {
+		job->type = NET_JOB_PRESENCE;
+		job->url.append(GRAPH_BASE_URL "/v1.0/me/presence");
+		job->method = "GET";
+		job->filter = &presenceResponseFilter();
+	} else {
+		job->type = NET_JOB_PRESENCE_BATCH;
+		job->url.append(GRAPH_BASE_URL "/v1.0/communications/getPresencesByUserId");
+		job->contentType = "application/json";
+		job->filter = &presenceBatchResponseFilter();
+		JsonDocument body;
+		JsonArray ids = body["ids"].to<JsonArray>();
+		for (uint8_t i = 0; i < gPresenceUserCount; ++i) ids.add(gPresenceUsers[i].id);
+		const size_t needed = measureJson(body);
+		job->payload.commit(needed <= job->payload.available()
+			? serializeJson(body, job->payload.end(), job->payload.available() + 1)
+			: needed); // too long: commit() flags the overflow and the job is not sent
+	}
+	postNetJob(job);
+}
+
+// Higher rank wins when several users are folded into one color
+static int presenceActivityRank(const String& act) {
+	static const char* const order[] = {
+		"Presenting", "InAConferenceCall", "InACall", "InAMeeting", "UrgentInterruptionsOnly",
+		"DoNotDisturb", "Busy", "BeRightBack", "Away", "Available", "Inactive",
+		"OffWork", "OutOfOffice", "Offline", "PresenceUnknown"
+	};
+	const int n = (int)(sizeof(order) / sizeof(order[0]));
+	for (int i = 0; i < n; ++i) {
+		if (act.equals(order[i])) return n - i;
+	}
+	return 0;
+}
+
+// Store a getPresencesByUserId response; availability/activity become the
+// highest-priority user's. Returns true when any user changed.
+static bool updatePresenceUsers(JsonDocument& responseDoc) {
+	bool changed = false;
+	for (JsonObject o : responseDoc["value"].as<JsonArray>()) {
+		const String id = o["id"] | "";
+		for (uint8_t i = 0; i < gPresenceUserCount; ++i) {
+			PresenceUser& u = gPresenceUsers[i];
+			if (!u.id.equalsIgnoreCase(id)) continue;
+			const String newAvailability = o["availability"] | "PresenceUnknown";
+			const String newActivity = o["activity"] | "PresenceUnknown";
+			changed = changed || newAvailability != u.availability || newActivity != u.activity;
+			u.availability = newAvailability;
+			u.activity = newActivity;
+			break;
+		}
+	}
+	int best = -1;
+	for (uint8_t i = 0; i < gPresenceUserCount; ++i) {
+		const int rank = presenceActivityRank(gPresenceUsers[i].activity);
+		if (rank > best) {
+			best = rank;
+			availability = gPresenceUsers[i].availability;
+			activity = gPresenceUsers[i].activity;
+		}
+	}
+	return changed;
+}
 
-	if (!res) {
+static void handlePresenceResult(NetJob& job) {
+	if (state != SMODEPOLLPRESENCE) return;
+	JsonDocument& responseDoc = job.response;
+	const uint32_t retryAfterS = responseDoc["_retry_after"] | 0;
+	if (retryAfterS > 0) {
+		DBG_PRINT("pollPresence() - Retry-After "); DBG_PRINTLN(retryAfterS);
+		tsPolling = max<unsigned long>(tsPolling, millis() + (retryAfterS * 1000UL));
+	}
+	if (!job.ok) {
 		state = SMODEPRESENCEREQUESTERROR;
 		retries++;
 	} else if (!responseDoc["error"].isNull()) {
@@ -1845,55 +2541,160 @@ void pollPresence() {
 			retries++;
 		}
 	} else {
-		availability = responseDoc["availability"].as<String>();
-		activity = responseDoc["activity"].as<String>();
+		bool changed;
+		if (job.type == NET_JOB_PRESENCE_BATCH) {
+			changed = updatePresenceUsers(responseDoc);
+		} else {
+			const String newAvailability = responseDoc["availability"].as<String>();
+			const String newActivity = responseDoc["activity"].as<String>();
+			changed = newAvailability != availability || newActivity != activity;
+			availability = newAvailability;
+			activity = newActivity;
+		}
 		retries = 0;
+		const uint32_t nextS = schedulePresencePoll(changed, retryAfterS);
+		tsPolling = millis() + (nextS * 1000UL);
+		DBG_PRINT("--> Availability: "); DBG_PRINT(availability.c_str()); DBG_PRINT(", Activity: "); DBG_PRINT(activity.c_str());
+		DBG_PRINT(", next poll in "); DBG_PRINT(nextS); DBG_PRINTLN(" s");
 
 		setPresenceAnimation();
 	}
 }
 
-// Refresh the access token
-boolean refreshToken() {
-	if (time(nullptr) < 1609459200) {
-		syncTime();
-	}
-	boolean success = false;
-	String payload;
-	String encodedClientId = urlEncodeFormValue(String(paramClientIdValue));
-	String encodedRefreshToken = urlEncodeFormValue(refresh_token);
-	payload.reserve(encodedClientId.length() + encodedRefreshToken.length() + 48);
-	payload += F("client_id=");
-	payload += encodedClientId;
-	payload += F("&grant_type=refresh_token&refresh_token=");
-	payload += encodedRefreshToken;
-	DBG_PRINTLN(F("refreshToken()"));
-	JsonDocument responseDoc;
-	boolean res = requestJsonApi(responseDoc, "https://login.microsoftonline.com/" + String(paramTenantValue) + "/oauth2/v2.0/token", payload, 0);
-	if (res && !responseDoc["access_token"].isNull() && !responseDoc["refresh_token"].isNull()) {
-		if (!responseDoc["access_token"].isNull()) {
-			access_token = responseDoc["access_token"].as<String>();
-			success = true;
-		}
-		if (!responseDoc["refresh_token"].isNull()) {
-			refresh_token = responseDoc["refresh_token"].as<String>();
-			success = true;
-		}
-		if (!responseDoc["id_token"].isNull()) {
-			id_token = responseDoc["id_token"].as<String>();
-		}
-		if (!responseDoc["expires_in"].isNull()) {
-			int _expires_in = responseDoc["expires_in"].as<unsigned int>();
-			expires = millis() + (_expires_in * 1000);
-		}
+// Pick the next background refresh point: a random 70-85% (TOKEN_REFRESH_PCT_*)
+// into the lifetime, so a fleet of devices does not renew in lockstep
+static void scheduleTokenRefresh(uint32_t expiresInS) {
+	const uint32_t pct = (uint32_t)random(TOKEN_REFRESH_PCT_MIN, TOKEN_REFRESH_PCT_MAX + 1);
+	uint32_t delayS = expiresInS * pct / 100;
+	if (expiresInS > TOKEN_REFRESH_TIMEOUT && delayS > expiresInS - TOKEN_REFRESH_TIMEOUT) {
+		delayS = expiresInS - TOKEN_REFRESH_TIMEOUT;
+	}
+	gTokenRefreshAtMs = millis() + (delayS * 1000UL);
+	if (gTokenRefreshAtMs == 0) gTokenRefreshAtMs = 1;
+	DBG_PRINT("Next token refresh in "); DBG_PRINT(delayS); DBG_PRINTLN(" s.");
+}
+
+// Refresh the access token; background refreshes leave the state machine polling.
+// A blocking refresh waits for an in-flight background one, which may still succeed.
+void refreshToken(bool background = false) {
+	if (gTokenRefreshPending) return;
+	NetJob* job = new NetJob();
+	job->type = background ? NET_JOB_TOKEN_REFRESH_BG : NET_JOB_TOKEN_REFRESH;
+	job->authGeneration = gAuthGeneration;
+	job->url.append(LOGIN_BASE_URL "/").append(paramTenantValue).append("/oauth2/v2.0/token");
+	job->payload.formField("client_id", paramClientIdValue);
+	job->payload.formField("grant_type", "refresh_token");
+	job->payload.formField("refresh_token", refresh_token);
+	job->filter = &tokenResponseFilter();
+	DBG_PRINTLN(background ? F("refreshToken() - background") : F("refreshToken()"));
+	postNetJob(job);
+}
+
+// Adopt the tokens from a refresh response; returns false if it carried none
+static bool applyRefreshedTokens(NetJob& job) {
+	JsonDocument& responseDoc = job.response;
+	if (!job.ok || responseDoc["access_token"].isNull() || responseDoc["refresh_token"].isNull()) return false;
+	access_token = responseDoc["access_token"].as<String>();
+	refresh_token = responseDoc["refresh_token"].as<String>();
+	if (!responseDoc["id_token"].isNull()) {
+		id_token = responseDoc["id_token"].as<String>();
+	}
+	if (!responseDoc["expires_in"].isNull()) {
+		unsigned int _expires_in = responseDoc["expires_in"].as<unsigned int>();
+		expires = millis() + (_expires_in * 1000);
+		scheduleTokenRefresh(_expires_in);
+	}
+	saveContextInBackground();
+	return true;
+}
+
+static void handleTokenRefreshResult(NetJob& job) {
+	if (state != SMODEREFRESHTOKEN || job.authGeneration != gAuthGeneration) return;
+	if (applyRefreshedTokens(job)) {
 		DBG_PRINTLN(F("refreshToken() - Success"));
 		state = SMODEPOLLPRESENCE;
 	} else {
 		DBG_PRINTLN(F("refreshToken() - Error:"));
-	DBG_PRINTLN(responseDoc.as<String>());
+	DBG_PRINTLN(job.response.as<String>());
 		tsPolling = millis() + (DEFAULT_ERROR_RETRY_INTERVAL * 1000);
 	}
-	return success;
+}
+
+static void handleBackgroundRefreshResult(NetJob& job) {
+	// Auth was reset or a new device login started while the request ran; the
+	// state alone cannot tell, since a quick re-login is back to polling already
+	if (job.authGeneration != gAuthGeneration) return;
+	if (state != SMODEPOLLPRESENCE && state != SMODEPRESENCEREQUESTERROR && state != SMODEREFRESHTOKEN) return;
+	if (applyRefreshedTokens(job)) {
+		DBG_PRINTLN(F("refreshToken() - background success"));
+		if (state == SMODEREFRESHTOKEN) state = SMODEPOLLPRESENCE;
+		return;
+	}
+	// Keep the current token and retry; the blocking refresh takes over near expiry
+	addLog("Background token refresh failed; retrying");
+	gTokenRefreshAtMs = millis() + (DEFAULT_ERROR_RETRY_INTERVAL * 1000UL);
+}
+
+// Runs every HTTPS request so appTask never blocks on TLS or slow endpoints
+void netTask(void * parameter) {
+	NetJob* job = nullptr;
+	for (;;) {
+		// Wake for cached DNS entries nearing expiry while no request is queued
+		const uint32_t dnsWaitMs = dnsCacheMsUntilRefresh();
+		const TickType_t wait = (dnsWaitMs == UINT32_MAX) ? portMAX_DELAY : pdMS_TO_TICKS(dnsWaitMs);
+		if (xQueueReceive(gNetRequestQueue, &job, wait) != pdTRUE) {
+			dnsCacheRefreshDue();
+			continue;
+		}
+		if (job->type == NET_JOB_SAVE_CONTEXT) {
+			if (job->authGeneration == gAuthGeneration) saveContextTokens(job->tokens);
+			job->tokens = AuthTokens();
+		} else if (job->type == NET_JOB_DNS_PREFETCH) {
+			dnsCachePrefetch(LOGIN_BASE_URL);
+			dnsCachePrefetch(GRAPH_BASE_URL);
+		} else if (job->url.overflowed() || job->payload.overflowed()) {
+			// Sending a truncated token or body would only earn a confusing error from the server
+			addLogf("Network job %u not sent: request exceeds %u bytes", (unsigned)job->type, (unsigned)job->payload.capacity());
+			job->ok = false;
+		} else {
+			job->ok = requestJsonApi(job->response, job->url.c_str(), job->payload.c_str(), job->payload.length(), job->method,
+				job->bearer.length() ? job->bearer.c_str() : nullptr, job->filter, job->contentType);
+		}
+		xQueueSend(gNetResultQueue, &job, portMAX_DELAY);
+	}
+}
+
+// Apply a finished network job on appTask
+static void processNetJobResults() {
+	NetJob* job = nullptr;
+	while (gNetResultQueue && xQueueReceive(gNetResultQueue, &job, 0) == pdTRUE) {
+		switch (job->type) {
+			case NET_JOB_DEVICE_CODE:
+				handleDeviceCodeResult(*job);
+				break;
+			case NET_JOB_TOKEN_POLL:
+				gStatemachineJobPending = false;
+				handleTokenPollResult(*job);
+				break;
+			case NET_JOB_PRESENCE:
+			case NET_JOB_PRESENCE_BATCH:
+				gStatemachineJobPending = false;
+				handlePresenceResult(*job);
+				break;
+			case NET_JOB_TOKEN_REFRESH:
+				gStatemachineJobPending = false;
+				handleTokenRefreshResult(*job);
+				break;
+			case NET_JOB_TOKEN_REFRESH_BG:
+				gTokenRefreshPending = false;
+				handleBackgroundRefreshResult(*job);
+				break;
+			case NET_JOB_SAVE_CONTEXT:
+			case NET_JOB_DNS_PREFETCH:
+				break;
+		}
+		delete job;
+	}
 }
 
 // Main application state machine
@@ -1911,7 +2712,9 @@ void statemachine() {
 		case SMODEWIFICONNECTED:
 			if (entered) {
 				setAnimation(0, FX_MODE_THEATER_CHASE, GREEN);
+				startTimeSync();
 				startMDNS();
+				prefetchMicrosoftHosts();
 				loadContext();
 				DBG_PRINTLN(F("Wifi connected, waiting for requests ..."));
 			}
@@ -1921,11 +2724,9 @@ void statemachine() {
 			if (entered) {
 				setAnimation(0, FX_MODE_THEATER_CHASE, PURPLE);
 			}
-			if (millis() >= tsPolling) {
+			if (millis() >= tsPolling && !gStatemachineJobPending) {
 				pollForToken();
-				if (state == SMODEDEVICELOGINSTARTED && millis() >= tsPolling) {
-					tsPolling = millis() + ((unsigned long)interval * 1000UL);
-				}
+				tsPolling = millis() + ((unsigned long)interval * 1000UL);
 			}
 			break;
 
@@ -1935,34 +2736,36 @@ void statemachine() {
 			break;
 
 		case SMODEAUTHREADY:
-			saveContext();
+			saveContextInBackground();
 			state = SMODEPOLLPRESENCE;
 			tsPolling = millis();
 			break;
 
 		case SMODEPOLLPRESENCE:
+			if (gTokenRefreshAtMs != 0 && !gTokenRefreshPending && (long)(millis() - gTokenRefreshAtMs) >= 0) {
+				refreshToken(true);
+			}
+			if (gStatemachineJobPending) break;
 			if (millis() >= tsPolling) {
 				DBG_PRINTLN(F("Polling presence info ..."));
 				pollPresence();
+				// Fallback if the request fails; a successful result reschedules adaptively
 				tsPolling = millis() + (getPollIntervalSeconds() * 1000);
-				DBG_PRINT("--> Availability: "); DBG_PRINT(availability.c_str()); DBG_PRINT(", Activity: "); DBG_PRINTLN(activity.c_str());
 			}
 
-			if (getTokenLifetime() < TOKEN_REFRESH_TIMEOUT) {
+			if (getTokenLifetime() < TOKEN_REFRESH_TIMEOUT && !gTokenRefreshPending) {
 				DBG_PRINT("Token needs refresh, valid for "); DBG_PRINT(getTokenLifetime()); DBG_PRINTLN(" s.");
 				state = SMODEREFRESHTOKEN;
 			}
 			break;
 
 		case SMODEREFRESHTOKEN:
-			if (entered) {
+			// Keep showing presence if there is one; the chase only covers a cold start
+			if (entered && availability.length() == 0) {
 				setAnimation(0, FX_MODE_THEATER_CHASE, RED);
 			}
-			if (millis() >= tsPolling) {
-				boolean success = refreshToken();
-				if (success) {
-					saveContext();
-				}
+			if (millis() >= tsPolling && !gStatemachineJobPending && !gTokenRefreshPending) {
+				refreshToken();
 			}
 			break;
 
@@ -1988,20 +2791,205 @@ void statemachine() {
 	}
 }
 
+// Copy the frame just sent to the strip into the snapshot buffer for readers
+static void publishFrameSnapshot() {
+	LedFrame& frame = gFrameSnapshot.back();
+	uint16_t count = min<uint16_t>(effects.length(), LED_MAX_COUNT);
+	for (uint16_t i = 0; i < count; ++i) {
+		frame.pixels[i] = effects.strip.getPixelColor(i);
+	}
+	frame.count = count;
+	frame.rgbw = effects.getPixelTypeRGBW();
+	gFrameSnapshot.publish();
+}
+
+// Sleep until the engine's next frame deadline (or a posted command).
+// msUntilNextFrame() counts from the slot's last frame, so the deadline is
+// taken from now and render cost does not stretch the period.
+// LED_FRAME_DELAY_MS bounds the whole wake-to-wake interval.
+static void waitForNextFrame(TickType_t& lastWake) {
+	const TickType_t now = xTaskGetTickCount();
+	TickType_t deadline;
+	if (gOtaVisualsActive) {
+		deadline = lastWake + pdMS_TO_TICKS(LED_IDLE_WAKE_MS);
+	} else if (gFade.active || (gRenderTargetSet && effects.getBrightness() != gRenderTargetBri)) {
+		deadline = lastWake + pdMS_TO_TICKS(LED_FRAME_DELAY_MS); // brightness ramp is driven from this task
+	} else {
+		deadline = now + pdMS_TO_TICKS(effects.msUntilNextFrame(LED_IDLE_WAKE_MS));
+	}
+	const TickType_t earliest = lastWake + pdMS_TO_TICKS(LED_FRAME_DELAY_MS);
+	if ((int32_t)(deadline - earliest) < 0) deadline = earliest;
+	// Fell behind (render longer than the period): still yield a tick to lower-priority tasks
+	if ((int32_t)(deadline - now) <= 0) deadline = now + 1;
+	ulTaskNotifyTake(pdTRUE, deadline - now);
+	lastWake = xTaskGetTickCount();
+}
+
 void neopixelTask(void * parameter) {
+	EffectsCommand cmd;
+	uint32_t publishedFrame = 0;
+	TickType_t lastWake = xTaskGetTickCount();
 	for (;;) {
-		EFFECTS_LOCK();
-		updateFade();
-		effects.service();
-		if (!gFade.active && gTarget.initialized) {
-			uint8_t cur = effects.getBrightness();
-			if (cur != gTarget.targetBri) {
-				effects.setBrightness(gTarget.targetBri);
+		while (xQueueReceive(gEffectsQueue, &cmd, 0) == pdTRUE) {
+			applyEffectsCommand(cmd);
+		}
+		if (!gOtaVisualsActive) {
+			updateFade();
+			effects.service();
+			if (!gFade.active && gRenderTargetSet) {
+				uint8_t cur = effects.getBrightness();
+				if (cur != gRenderTargetBri) {
+					effects.setBrightness(gRenderTargetBri);
+				}
 			}
 		}
-		EFFECTS_UNLOCK();
-		// Frame pacing: use LED_FRAME_DELAY_MS (configured per target in config.h)
-		vTaskDelay(LED_FRAME_DELAY_MS / portTICK_PERIOD_MS);
+		if (effects.getFrameCount() != publishedFrame) {
+			publishedFrame = effects.getFrameCount();
+			publishFrameSnapshot();
+		}
+		// Frame pacing: LED_FRAME_DELAY_MS (config.h) is the shortest period
+		waitForNextFrame(lastWake);
+	}
+}
+
+// Live LED mirror: chunked HTTP responses carrying packed binary frames.
+// Frame layout (little endian): 'S','G', version, bytes per pixel, seq (u32),
+// count (u16), reserved (u16), then count * bpp bytes of R,G,B[,W].
+// Serviced from appTask, the only gFrameSnapshot reader. Writes never block:
+// a frame the socket cannot take yet is skipped, and the unsent tail of a
+// partly written one is kept per client and flushed on later passes.
+#define LED_STREAM_HEADER_BYTES 12
+#define LED_STREAM_VERSION 1
+
+struct LedStreamClient {
+	WiFiClient client;
+	bool active = false;
+	uint16_t intervalMs = 0;
+	uint32_t lastSeq = 0;
+	unsigned long lastSentMs = 0;
+	unsigned long lastProgressMs = 0;
+	uint8_t* backlog = nullptr; // unsent tail of the current chunk
+	size_t backlogLen = 0;
+};
+static LedStreamClient gLedStreams[LED_STREAM_MAX_CLIENTS];
+// Chunk size line + header + pixels + trailing CRLF
+static uint8_t gLedStreamBuf[8 + LED_STREAM_HEADER_BYTES + LED_MAX_COUNT * 4 + 2];
+
+static size_t buildLedStreamChunk(const LedFrame& frame) {
+	const uint8_t bpp = frame.rgbw ? 4 : 3;
+	const size_t payloadLen = LED_STREAM_HEADER_BYTES + (size_t)frame.count * bpp;
+	uint8_t* p = gLedStreamBuf + snprintf((char*)gLedStreamBuf, 8, "%X\r\n", (unsigned)payloadLen);
+	*p++ = 'S';
+	*p++ = 'G';
+	*p++ = LED_STREAM_VERSION;
+	*p++ = bpp;
+	for (int i = 0; i < 4; ++i) *p++ = (uint8_t)(frame.seq >> (8 * i));
+	*p++ = (uint8_t)(frame.count & 0xFF);
+	*p++ = (uint8_t)(frame.count >> 8);
+	*p++ = 0;
+	*p++ = 0;
+	for (uint16_t i = 0; i < frame.count; ++i) {
+		uint32_t c = frame.pixels[i];
+		*p++ = (uint8_t)(c >> 16);
+		*p++ = (uint8_t)(c >> 8);
+		*p++ = (uint8_t)c;
+		if (bpp == 4) *p++ = (uint8_t)(c >> 24);
+	}
+	*p++ = '\r';
+	*p++ = '\n';
+	return p - gLedStreamBuf;
+}
+
+static void dropLedStream(LedStreamClient& s) {
+	s.client.stop();
+	s.client = WiFiClient();
+	s.active = false;
+	free(s.backlog);
+	s.backlog = nullptr;
+	s.backlogLen = 0;
+}
+
+// Bytes the socket took without waiting (0 when its buffer is full), or -1 on error
+static int ledStreamSend(LedStreamClient& s, const uint8_t* data, size_t len) {
+	const int n = send(s.client.fd(), data, len, MSG_DONTWAIT);
+	if (n >= 0) return n;
+	return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+}
+
+// False when the client has to be dropped
+static bool flushLedStreamBacklog(LedStreamClient& s, unsigned long now) {
+	if (s.backlogLen == 0) return true;
+	const int n = ledStreamSend(s, s.backlog, s.backlogLen);
+	if (n < 0) return false;
+	if (n == 0) return (now - s.lastProgressMs) < LED_STREAM_STALL_MS;
+	memmove(s.backlog, s.backlog + n, s.backlogLen - n);
+	s.backlogLen -= n;
+	s.lastProgressMs = now;
+	return true;
+}
+
+static bool beginLedStream(uint16_t fps) {
+	LedStreamClient* slot = nullptr;
+	for (auto& s : gLedStreams) {
+		if (s.active && !s.client.connected()) dropLedStream(s);
+		if (!s.active && !slot) slot = &s;
+	}
+	if (!slot) return false;
+	WiFiClient client = server.detachClient();
+	if (!client.connected()) return false;
+	client.setNoDelay(true);
+	client.print(F("HTTP/1.1 200 OK\r\n"
+		"Content-Type: application/octet-stream\r\n"
+		"Cache-Control: no-store\r\n"
+		"Transfer-Encoding: chunked\r\n"
+		"Connection: close\r\n\r\n"));
+	slot->backlog = (uint8_t*)malloc(sizeof(gLedStreamBuf));
+	if (!slot->backlog) {
+		client.stop();
+		return true; // headers are out, so the request is answered either way
+	}
+	slot->backlogLen = 0;
+	slot->client = client;
+	slot->active = true;
+	slot->intervalMs = 1000 / fps;
+	slot->lastSeq = 0;
+	slot->lastSentMs = millis() - slot->intervalMs;
+	slot->lastProgressMs = millis();
+	return true;
+}
+
+static void serviceLedStreams() {
+	bool any = false;
+	for (auto& s : gLedStreams) any |= s.active;
+	if (!any) return;
+	const LedFrame& frame = gFrameSnapshot.latest();
+	if (frame.seq == 0) return;
+	const unsigned long now = millis();
+	size_t chunkLen = 0;
+	for (auto& s : gLedStreams) {
+		if (!s.active) continue;
+		if (!s.client.connected() || !flushLedStreamBacklog(s, now)) {
+			dropLedStream(s);
+			continue;
+		}
+		if (s.backlogLen) continue; // still behind on the previous frame
+		const unsigned long since = now - s.lastSentMs;
+		if (since < s.intervalMs) continue;
+		if (frame.seq == s.lastSeq && since < LED_STREAM_KEEPALIVE_MS) continue;
+		if (chunkLen == 0) chunkLen = buildLedStreamChunk(frame);
+		const int n = ledStreamSend(s, gLedStreamBuf, chunkLen);
+		if (n < 0 || (n == 0 && (now - s.lastProgressMs) >= LED_STREAM_STALL_MS)) {
+			dropLedStream(s);
+			continue;
+		}
+		if (n == 0) continue; // socket full: skip this frame
+		if ((size_t)n < chunkLen) {
+			memcpy(s.backlog, gLedStreamBuf + n, chunkLen - n);
+			s.backlogLen = chunkLen - n;
+		}
+		s.lastSeq = frame.seq;
+		s.lastSentMs = now;
+		s.lastProgressMs = now;
 	}
 }
 
@@ -2010,9 +2998,12 @@ void appTask(void * parameter) {
 		if (gApEnabled) dnsServer.processNextRequest();
 		processWifiConnectJob();
 		processWifiScanJob();
+		processNetJobResults();
 		server.handleClient();
+		serviceLedStreams();
 		processPendingSoftAPStop();
 		updateStatusLed();
+		updateRtcTime();
 		statemachine();
 		vTaskDelay(15 / portTICK_PERIOD_MS);
 	}
@@ -2029,7 +3020,10 @@ void setup()
 		DBG_PRINTLN(F("WARNING: Checking of HTTPS certificates disabled."));
 	#endif
 
-	gEffectsMutex = xSemaphoreCreateMutex();
+	restoreRtcTime();
+	gEffectsQueue = xQueueCreate(EFFECTS_QUEUE_DEPTH, sizeof(EffectsCommand));
+	gNetRequestQueue = xQueueCreate(NET_QUEUE_DEPTH, sizeof(NetJob*));
+	gNetResultQueue = xQueueCreate(NET_QUEUE_DEPTH, sizeof(NetJob*));
 	// Improve signal integrity for WS2812 data pin (especially on S3 at 5V LED power)
 	pinMode(DATAPIN, OUTPUT);
 	digitalWrite(DATAPIN, LOW);
@@ -2045,9 +3039,7 @@ void setup()
 	effects.start();
 	// Initialize LED count early so setAnimation uses a valid range; loadAppConfig() may override later
 	numberLeds = NUMLEDS;
-	EFFECTS_LOCK();
-	effects.setLength(numberLeds);
-	EFFECTS_UNLOCK();
+	postEffectsLength(numberLeds);
 	setAnimation(0, FX_MODE_STATIC, BLACK);
 	playStartupSequence();
 	
@@ -2059,8 +3051,14 @@ void setup()
 	// Initialize optional status LED only if enabled (pin from config)
 	ensureStatusLedReady();
 	
-	const char* collectedHeaders[] = { "X-StatusGlow-Key", "X-OTA-Key", "Accept-Encoding" };
-	server.collectHeaders(collectedHeaders, 3);
+	if (gUiBundle.begin()) {
+		addLogf("Web UI: %u assets from the " UI_BUNDLE_PARTITION_LABEL " partition (%u bytes)", (unsigned)gUiBundle.count(), (unsigned)gUiBundle.size());
+	} else if (gUiBundle.hasPartition()) {
+		addLog("Web UI: no valid bundle in the " UI_BUNDLE_PARTITION_LABEL " partition, using the embedded UI");
+	}
+
+	const char* collectedHeaders[] = { "X-StatusGlow-Key", "X-OTA-Key", "Accept-Encoding", "If-None-Match" };
+	server.collectHeaders(collectedHeaders, 4);
 	loadEffectsConfig();
 	loadWifiPrefs();
 	
@@ -2155,10 +3153,7 @@ void setup()
 					if (target <= 75 && pct >= target) { otaLogf("OTA progress: %d%%", target); s_ota_milestone++; }
 				}
 				static bool t = false; t = !t;
-				EFFECTS_LOCK();
-				effects.strip.setPixelColor(0, t ? effects.Color(255,255,255) : effects.Color(0,0,0));
-				effects.strip.show();
-				EFFECTS_UNLOCK();
+				showOtaProgressPixel(t);
 			} else if (upload.status == UPLOAD_FILE_END) {
 				bool ok = Update.end(true);
 				if (ok) {
@@ -2171,6 +3166,46 @@ void setup()
 			}
 		}
 	);
+	// The UI bundle is flashed on its own, so a firmware OTA does not have to carry the web UI
+	server.on("/update_ui", HTTP_GET, []() {
+		if (!requireOtaAuth()) { otaLog("UI OTA GET /update_ui unauthorized"); return; }
+		String page = buildOtaUploadPage("/update_ui", "bundle", "Web UI Bundle OTA");
+		server.send(200, "text/html", page);
+	});
+	server.on("/update_ui", HTTP_POST,
+		[]() {
+			if (!requireOtaAuth()) { otaLog("UI OTA POST unauthorized"); return; }
+			const bool ok = gUiBundle.active();
+			otaLogf("UI OTA POST finalize: %s", ok ? "OK" : "FAIL");
+			server.send(ok ? 200 : 500, "text/plain", ok ? "OK" : "FAIL");
+		},
+		[]() {
+			if (!isRequestAuthorized(gOtaSharedKey.c_str())) { otaLog("UI OTA upload unauthorized (chunk)"); return; }
+			HTTPUpload &upload = server.upload();
+			if (upload.status == UPLOAD_FILE_START) {
+				gOtaLog = String();
+				otaLogf("UI OTA start: %s", upload.filename.c_str());
+				if (!gUiBundle.beginWrite()) {
+					otaLog("UI OTA failed: no " UI_BUNDLE_PARTITION_LABEL " partition in this partition table");
+				}
+			} else if (upload.status == UPLOAD_FILE_WRITE) {
+				const bool alreadyFailed = gUiBundle.writeFailed();
+				if (!gUiBundle.write(upload.buf, upload.currentSize) && !alreadyFailed) {
+					otaLogf("UI OTA write failed at %u of %u bytes", (unsigned)gUiBundle.written(), (unsigned)gUiBundle.partitionSize());
+				}
+			} else if (upload.status == UPLOAD_FILE_END) {
+				if (gUiBundle.endWrite()) {
+					otaLogf("UI OTA end OK: %u assets, size=%u", (unsigned)gUiBundle.count(), (unsigned)gUiBundle.size());
+				} else {
+					otaLogf("UI OTA end failed after %u bytes; serving the embedded UI", (unsigned)gUiBundle.written());
+				}
+				otaLogSaveToPrefs();
+			} else if (upload.status == UPLOAD_FILE_ABORTED) {
+				otaLog("UI OTA aborted; serving the embedded UI");
+				otaLogSaveToPrefs();
+			}
+		}
+	);
 	if (strlen(paramClientIdValue) == 0) {
 		strlcpy(paramClientIdValue, "3837bbf0-30fb-47ad-bce8-f460ba9880c3", sizeof(paramClientIdValue));
 	}
@@ -2244,6 +3279,8 @@ void setup()
 		d["uptime_ms"] = millis();
 		d["cpu"] = (int)ESP.getCpuFreqMHz();
 		d["heap_free"] = (int)ESP.getFreeHeap();
+		// Bytes of LED_TASK_STACK the render task has never touched
+		d["led_stack_free"] = TaskNeopixel ? (int)uxTaskGetStackHighWaterMark(TaskNeopixel) : 0;
 		sendJsonDocument(200, d);
 	});
 	server.on("/api/ota_last", HTTP_GET, [] {
@@ -2276,6 +3313,10 @@ void setup()
 		if (!requireAdminAuth()) return;
 		handleGetSettings();
 	});
+	server.on("/api/net_stats", HTTP_GET, [] {
+		if (!requireAdminAuth()) return;
+		handleGetNetStats();
+	});
 	server.on("/logs", HTTP_ANY, [] {
 		if (isSetupPortalActive()) {
 			serveSetupPortalPage();
@@ -2432,6 +3473,18 @@ void setup()
 			gStatusLedEnabled = doc["status_led_enabled"].as<bool>();
 			ensureStatusLedReady();
 		}
+		if (!doc["presence_layout"].isNull()) {
+			gPresenceLayout = parsePresenceLayout(doc["presence_layout"].as<String>());
+		}
+		if (!doc["presence_users"].isNull()) {
+			const bool hadUsers = gPresenceUserCount > 0;
+			if (setPresenceUsersFromJson(doc["presence_users"])) {
+				// Moving between /me and other users' presence changes the Graph scope
+				authConfigChanged = authConfigChanged || (hadUsers != (gPresenceUserCount > 0));
+				tsPolling = 0;
+			}
+		}
+		if (state == SMODEPOLLPRESENCE) setPresenceAnimation();
 		if (authConfigChanged) {
 			access_token = "";
 			refresh_token = "";
@@ -2490,17 +3543,13 @@ void setup()
 			}
 			if (!doc["brightness"].isNull()) {
 				gDefaultBrightness = (uint8_t)doc["brightness"].as<unsigned int>();
-				EFFECTS_LOCK();
-				effects.setBrightness(gDefaultBrightness);
-				EFFECTS_UNLOCK();
+				postEffectsBrightness(gDefaultBrightness);
 			}
 			if (!doc["gamma"].isNull()) {
 				gGamma = doc["gamma"].as<float>();
 				if (isnan(gGamma) || gGamma < 0.1f) gGamma = 2.2f;
 				if (gGamma > 5.0f) gGamma = 5.0f;
-				EFFECTS_LOCK();
-				effects.setGamma(gGamma);
-				EFFECTS_UNLOCK();
+				postEffectsGamma(gGamma);
 			}
 			if (!doc["profiles"].isNull() && doc["profiles"].is<JsonArray>()) {
 				JsonArray arr = doc["profiles"].as<JsonArray>();
@@ -2553,24 +3602,67 @@ void setup()
 			if (!doc["color"].isNull()) color = doc["color"].as<uint32_t>();
 			if (!doc["fade_ms"].isNull()) perFade = (uint16_t)doc["fade_ms"].as<unsigned int>();
 			if (!doc["bri"].isNull()) perBri = (uint8_t)doc["bri"].as<unsigned int>();
-			EFFECTS_LOCK();
-			gFade.durationMs = perFade;
+			gNextFadeMs = perFade;
 			gNextTargetBri = perBri;
-			EFFECTS_UNLOCK();
 			setAnimation(0, mode, color, speed, reverse);
 			sendApiOk(200);
 		});
+		// Overlay layers above the presence effect (segment 0), e.g. a call-state bar
+		server.on("/api/segment", HTTP_POST, [] {
+			if (!requireAdminAuth()) return;
+			JsonDocument doc;
+			if (!parseJsonBody(doc)) return;
+			if (gPresenceSegmentsShown > 0) {
+				sendApiError(409, "segments_layout_active", "The team segments layout is using every layer; switch to the aggregate layout to add overlays.");
+				return;
+			}
+			int segment = doc["segment"] | 0;
+			if (segment < 1 || segment >= LED_EFFECTS_MAX_SEGMENTS) {
+				sendApiError(400, "invalid_segment", "Segment must be between 1 and the engine's last layer.");
+				return;
+			}
+			EffectsCommand cmd;
+			cmd.segment = (uint8_t)segment;
+			if (doc["clear"] | false) {
+				cmd.type = EFFECTS_CMD_SEGMENT_CLEAR;
+				postEffectsCommand(cmd);
+				sendApiOk(200);
+				return;
+			}
+			int start = doc["start"] | 0;
+			int end = doc["end"] | numberLeds;
+			start = constrain(start, 0, numberLeds);
+			end = constrain(end, start, numberLeds);
+			cmd.type = EFFECTS_CMD_SEGMENT;
+			cmd.start = (uint16_t)start;
+			cmd.length = (uint16_t)end;
+			cmd.mode = (uint16_t)(doc["mode"] | (unsigned int)FX_MODE_STATIC);
+			if (cmd.mode >= effects.getModeCount()) cmd.mode = FX_MODE_STATIC;
+			cmd.color = doc["color"] | (uint32_t)WHITE;
+			if (!doc["speed"].isNull()) {
+				float sp = doc["speed"].as<float>();
+				if (sp < 0) sp = 0;
+				uint32_t ms = (uint32_t)(sp * 1000.0f + 0.5f);
+				if (ms > 600000) ms = 600000;
+				cmd.speed = (uint16_t)ms;
+			}
+			cmd.reverse = doc["reverse"] | false;
+			cmd.fadeMs = (uint16_t)(doc["fade_ms"] | (unsigned int)gFadeDurationMs);
+			String blend = doc["blend"] | "replace";
+			cmd.blend = blend.equals("add") ? SEG_BLEND_ADD : (blend.equals("alpha") ? SEG_BLEND_ALPHA : SEG_BLEND_REPLACE);
+			cmd.opacity = (uint8_t)(doc["opacity"] | 255);
+			postEffectsCommand(cmd);
+			sendApiOk(200);
+		});
 		server.on("/api/leds", HTTP_POST, [] {
 			if (!requireAdminAuth()) return;
 			JsonDocument doc;
 			if (!parseJsonBody(doc)) return;
 			if (doc["num_leds"].isNull()) { sendApiError(400, "missing_num_leds", "Provide the LED count to apply."); return; }
 			int n = (int)doc["num_leds"].as<int>();
-			if (n < 1) n = 1; if (n > 1024) n = 1024;
+			if (n < 1) n = 1; if (n > LED_MAX_COUNT) n = LED_MAX_COUNT;
 			numberLeds = n;
-			EFFECTS_LOCK();
-			effects.setLength(numberLeds);
-			EFFECTS_UNLOCK();
+			postEffectsLength(numberLeds);
 		saveAppConfig();
 			JsonDocument resp; resp["ok"] = true; resp["num_leds"] = numberLeds; sendJsonDocument(200, resp);
 		});
@@ -2628,17 +3720,25 @@ void setup()
 		});
 		server.on("/api/led_frame", HTTP_GET, [] {
 			if (!requireAdminAuth()) return;
+			const LedFrame& snapshot = gFrameSnapshot.latest();
 			JsonDocument d;
 			d["ok"] = true;
-			d["num_leds"] = numberLeds;
+			d["num_leds"] = snapshot.count;
+			d["seq"] = snapshot.seq;
 			JsonArray frame = d["frame"].to<JsonArray>();
-			EFFECTS_LOCK();
-			for (int i = 0; i < numberLeds; ++i) {
-				frame.add((uint32_t)effects.strip.getPixelColor(i));
+			for (uint16_t i = 0; i < snapshot.count; ++i) {
+				frame.add(snapshot.pixels[i]);
 			}
-			EFFECTS_UNLOCK();
 			sendJsonDocument(200, d);
 		});
+		server.on("/api/led_stream", HTTP_GET, [] {
+			if (!requireAdminAuth()) return;
+			long fps = server.hasArg("fps") ? server.arg("fps").toInt() : LED_STREAM_DEFAULT_FPS;
+			fps = constrain(fps, 1L, (long)LED_STREAM_MAX_FPS);
+			if (!beginLedStream((uint16_t)fps)) {
+				sendApiError(503, "stream_busy", "Too many live LED streams are open.");
+			}
+		});
 	server.on("/effects", HTTP_ANY, []() {
 			if (isSetupPortalActive()) {
 				serveSetupPortalPage();
@@ -2652,7 +3752,8 @@ void setup()
 			handleCaptivePortalRequest();
 			return;
 		}
-		if (isAllowedPublicAssetPath(server.uri()) && serveEmbeddedAssetPath(server.uri())) return;
+		const String& uri = server.uri();
+		if (isAllowedPublicAssetPath(uri.c_str()) && serveEmbeddedAssetPath(uri.c_str())) return;
 		server.send(404, "text/plain", "FileNotFound");
 	});
 	server.begin();
@@ -2660,7 +3761,7 @@ void setup()
 	xTaskCreatePinnedToCore(
 		neopixelTask,
 		"Neopixels",
-		2048,
+		LED_TASK_STACK,
 		NULL,
 		3,
 		&TaskNeopixel,
@@ -2673,6 +3774,14 @@ void setup()
 		2,
 		&TaskApp,
 		APP_TASK_CORE);
+	xTaskCreatePinnedToCore(
+		netTask,
+		"StatusGlowNet",
+		8192,
+		NULL,
+		1,
+		&TaskNet,
+		APP_TASK_CORE);
 }
 
 // Update status LED based on current state
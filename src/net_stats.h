@@ -0,0 +1,143 @@
+// Per-endpoint timing and traffic counters for requestJsonApi().
+//
+// The network task records one sample per request attempt; the web handler
+// copies everything out with snapshot(). Both sides hold a spinlock only for
+// the copy, so recording never waits on a slow HTTP client.
+//
+// WiFiClientSecure performs the TCP connect and TLS handshake in one call, and
+// HTTPClient writes the request and waits for the status line in one call, so
+// those pairs are reported as single phases. With a Content-Length the body is
+// parsed straight off the socket, so body read and JSON parse are one phase too.
+
+#pragma once
+#include <Arduino.h>
+#include <string.h>
+#include "config.h"
+
+enum NetEndpoint : uint8_t {
+  NET_EP_PRESENCE = 0,
+  NET_EP_PRESENCE_BATCH = 1,
+  NET_EP_TOKEN = 2,
+  NET_EP_DEVICE_CODE = 3,
+  NET_EP_OTHER = 4,
+  NET_EP_COUNT
+};
+
+enum NetPhase : uint8_t {
+  NET_PHASE_DNS = 0,         // hostname lookup (new connections only)
+  NET_PHASE_CONNECT = 1,     // TCP connect + TLS handshake (new connections only)
+  NET_PHASE_FIRST_BYTE = 2,  // request write until response headers
+  NET_PHASE_READ_PARSE = 3,  // body read + JSON parse
+  NET_PHASE_TOTAL = 4,
+  NET_PHASE_COUNT
+};
+
+// Histogram bucket upper bounds (ms); one more bucket counts anything slower
+static const uint16_t kNetStatsBucketMs[] = {10, 25, 50, 100, 250, 500, 1000, 2500, 5000};
+#define NET_STATS_BUCKETS ((sizeof(kNetStatsBucketMs) / sizeof(kNetStatsBucketMs[0])) + 1)
+
+struct NetSample {
+  uint32_t phaseMs[NET_PHASE_COUNT] = {0};
+  bool phaseSeen[NET_PHASE_COUNT] = {false};
+  uint32_t bytesOut = 0;      // request body
+  uint32_t bytesIn = 0;       // response body
+  int httpStatus = 0;         // HTTP status, or a negative HTTPC_ERROR_* code
+  bool ok = false;
+  bool reused = false;        // sent on a kept-alive connection
+  bool insecureRetry = false; // certificate validation was skipped
+
+  void setPhase(NetPhase phase, uint32_t ms) {
+    phaseMs[phase] = ms;
+    phaseSeen[phase] = true;
+  }
+};
+
+struct NetPhaseStats {
+  uint32_t count;
+  uint32_t sumMs;
+  uint32_t maxMs;
+  uint32_t hist[NET_STATS_BUCKETS];
+};
+
+struct NetEndpointStats {
+  uint32_t requests;
+  uint32_t failures;
+  uint32_t reused;
+  uint32_t insecureRetries;
+  uint32_t status2xx;
+  uint32_t status4xx;
+  uint32_t status5xx;
+  uint32_t statusError; // no HTTP status (connect, TLS or read failure)
+  uint64_t bytesOut;
+  uint64_t bytesIn;
+  NetPhaseStats phases[NET_PHASE_COUNT];
+  NetSample last;
+};
+
+class NetStats {
+public:
+  static NetEndpoint classify(const char* url) {
+    if (strstr(url, "/me/presence")) return NET_EP_PRESENCE;
+    if (strstr(url, "/getPresencesByUserId")) return NET_EP_PRESENCE_BATCH;
+    if (strstr(url, "/oauth2/v2.0/token")) return NET_EP_TOKEN;
+    if (strstr(url, "/oauth2/v2.0/devicecode")) return NET_EP_DEVICE_CODE;
+    return NET_EP_OTHER;
+  }
+
+  static const char* endpointName(uint8_t ep) {
+    static const char* const names[NET_EP_COUNT] = {"presence", "presence_batch", "token", "devicecode", "other"};
+    return ep < NET_EP_COUNT ? names[ep] : "other";
+  }
+
+  static const char* phaseName(uint8_t phase) {
+    static const char* const names[NET_PHASE_COUNT] = {"dns", "connect_tls", "first_byte", "read_parse", "total"};
+    return phase < NET_PHASE_COUNT ? names[phase] : "";
+  }
+
+  NetStats() { memset(_eps, 0, sizeof(_eps)); }
+
+  void record(NetEndpoint ep, const NetSample& s) {
+    if (ep >= NET_EP_COUNT) ep = NET_EP_OTHER;
+    portENTER_CRITICAL(&_lock);
+    NetEndpointStats& st = _eps[ep];
+    st.requests++;
+    if (!s.ok) st.failures++;
+    if (s.reused) st.reused++;
+    if (s.insecureRetry) st.insecureRetries++;
+    if (s.httpStatus >= 200 && s.httpStatus < 300) st.status2xx++;
+    else if (s.httpStatus >= 400 && s.httpStatus < 500) st.status4xx++;
+    else if (s.httpStatus >= 500) st.status5xx++;
+    else if (s.httpStatus <= 0) st.statusError++;
+    st.bytesOut += s.bytesOut;
+    st.bytesIn += s.bytesIn;
+    for (uint8_t p = 0; p < NET_PHASE_COUNT; ++p) {
+      if (!s.phaseSeen[p]) continue;
+      NetPhaseStats& ph = st.phases[p];
+      const uint32_t ms = s.phaseMs[p];
+      ph.count++;
+      ph.sumMs += ms;
+      if (ms > ph.maxMs) ph.maxMs = ms;
+      uint8_t b = 0;
+      while (b < NET_STATS_BUCKETS - 1 && ms > kNetStatsBucketMs[b]) b++;
+      ph.hist[b]++;
+    }
+    st.last = s;
+    portEXIT_CRITICAL(&_lock);
+  }
+
+  void snapshot(NetEndpointStats (&out)[NET_EP_COUNT]) {
+    portENTER_CRITICAL(&_lock);
+    memcpy(out, _eps, sizeof(_eps));
+    portEXIT_CRITICAL(&_lock);
+  }
+
+  void reset() {
+    portENTER_CRITICAL(&_lock);
+    memset(_eps, 0, sizeof(_eps));
+    portEXIT_CRITICAL(&_lock);
+  }
+
+private:
+  NetEndpointStats _eps[NET_EP_COUNT];
+  portMUX_TYPE _lock = portMUX_INITIALIZER_UNLOCKED;
+};
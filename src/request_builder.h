@@ -0,0 +1,111 @@
+// Fixed-capacity text buffer for request URLs and bodies.
+//
+// Appends go straight into the inline buffer and form values are
+// percent-encoded in place, so building a request never allocates. An append
+// that does not fit is dropped and sets overflowed(); callers check that once
+// before sending instead of after every append.
+
+#pragma once
+#include <Arduino.h>
+#include <string.h>
+
+template <size_t N>
+class RequestBuilder {
+public:
+  static_assert(N > 1, "RequestBuilder needs room for at least one character");
+
+  RequestBuilder() { clear(); }
+
+  void clear() {
+    _len = 0;
+    _buf[0] = '\0';
+    _overflow = false;
+  }
+
+  RequestBuilder& append(const char* s) { return append(s, strlen(s)); }
+
+  RequestBuilder& append(const char* s, size_t n) {
+    if (n > available()) {
+      _overflow = true;
+      return *this;
+    }
+    memcpy(_buf + _len, s, n);
+    _len += n;
+    _buf[_len] = '\0';
+    return *this;
+  }
+
+  RequestBuilder& append(const String& s) { return append(s.c_str(), s.length()); }
+
+  // application/x-www-form-urlencoded: unreserved characters as is, space as '+'
+  RequestBuilder& appendFormEncoded(const char* s) {
+    static const char hex[] = "0123456789ABCDEF";
+    const size_t start = _len;
+    for (; *s; ++s) {
+      const unsigned char c = (unsigned char)*s;
+      const size_t need = isUnreserved(c) || c == ' ' ? 1 : 3;
+      if (need > available()) {
+        // Never leave half a value behind
+        _len = start;
+        _buf[_len] = '\0';
+        _overflow = true;
+        return *this;
+      }
+      if (isUnreserved(c)) {
+        _buf[_len++] = (char)c;
+      } else if (c == ' ') {
+        _buf[_len++] = '+';
+      } else {
+        _buf[_len++] = '%';
+        _buf[_len++] = hex[(c >> 4) & 0x0F];
+        _buf[_len++] = hex[c & 0x0F];
+      }
+    }
+    _buf[_len] = '\0';
+    return *this;
+  }
+
+  RequestBuilder& appendFormEncoded(const String& s) { return appendFormEncoded(s.c_str()); }
+
+  // Appends "key=value", preceded by '&' unless the buffer is empty; only the value is encoded
+  RequestBuilder& formField(const char* key, const char* value) {
+    if (_len > 0) append("&", 1);
+    append(key);
+    append("=", 1);
+    return appendFormEncoded(value);
+  }
+
+  RequestBuilder& formField(const char* key, const String& value) { return formField(key, value.c_str()); }
+
+  // Raw space for writers such as serializeJson(); report the bytes written with commit()
+  char* end() { return _buf + _len; }
+  size_t available() const { return N - 1 - _len; }
+  // A count larger than available() marks the buffer overflowed and keeps the text unchanged
+  void commit(size_t n) {
+    if (n > available()) {
+      _overflow = true;
+      _buf[_len] = '\0';
+      return;
+    }
+    _len += n;
+    _buf[_len] = '\0';
+  }
+
+  const char* c_str() const { return _buf; }
+  size_t length() const { return _len; }
+  bool isEmpty() const { return _len == 0; }
+  bool overflowed() const { return _overflow; }
+  static constexpr size_t capacity() { return N - 1; }
+
+private:
+  static bool isUnreserved(unsigned char c) {
+    return (c >= 'A' && c <= 'Z') ||
+      (c >= 'a' && c <= 'z') ||
+      (c >= '0' && c <= '9') ||
+      c == '-' || c == '_' || c == '.' || c == '~';
+  }
+
+  char _buf[N];
+  size_t _len = 0;
+  bool _overflow = false;
+};
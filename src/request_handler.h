@@ -1,108 +1,421 @@
 #include "config.h"
+#include "net_stats.h"
+#include "request_builder.h"
+#include <new>
 
-extern void syncTime();
+extern bool waitForTimeSync(uint32_t timeoutMs);
 extern bool gApEnabled;
 extern String gApSsid;
 extern bool gStatusLedEnabled;
 extern const uint8_t x509_crt_bundle[];
 
-boolean requestJsonApi(JsonDocument& doc, String url, String payload = "", size_t capacity = 0, String type = "POST", boolean sendAuth = false) {
+// Kept-alive HTTPS connections, one slot per host. Only netTask issues requests,
+// so the pool needs no locking. HTTPClient stops its socket when destroyed, so
+// both objects live here rather than on the request's stack.
+struct HttpsConnection {
+	String host;
+	WiFiClientSecure tls;
+	HTTPClient http;
+	bool insecure = false;
+	unsigned long lastUsedMs = 0;
+};
+
+static HttpsConnection gHttpsPool[HTTPS_POOL_SIZE];
+static uint32_t gHttpsHandshakes = 0; // requests that had to open a new TLS session
+static uint32_t gHttpsReused = 0;     // requests sent on a kept-alive connection
+static NetStats gNetStats;
+
+// Resolved addresses for the Microsoft hosts, so DNS stays off the request path.
+// Like the connection pool, only netTask touches this.
+struct DnsCacheEntry {
+	String host;
+	IPAddress addr;
+	bool valid = false;
+	unsigned long expiresMs = 0;
+	unsigned long refreshAtMs = 0; // next background lookup
+};
+
+static DnsCacheEntry gDnsCache[DNS_CACHE_SIZE];
+static uint32_t gDnsCacheHits = 0;
+static uint32_t gDnsCacheMisses = 0;
+
+static DnsCacheEntry& dnsCacheSlot(const String& host) {
+	DnsCacheEntry* victim = &gDnsCache[0];
+	for (auto& entry : gDnsCache) {
+		if (entry.host == host) return entry;
+		if (victim->host.length() && (entry.host.isEmpty() || (long)(entry.expiresMs - victim->expiresMs) < 0)) {
+			victim = &entry;
+		}
+	}
+	*victim = DnsCacheEntry();
+	victim->host = host;
+	return *victim;
+}
+
+static bool dnsCacheRefresh(DnsCacheEntry& entry) {
+	IPAddress addr;
+	const unsigned long now = millis();
+	if (WiFi.hostByName(entry.host.c_str(), addr) != 1) {
+		entry.refreshAtMs = now + (DNS_CACHE_RETRY_S * 1000UL);
+		return false;
+	}
+	entry.addr = addr;
+	entry.valid = true;
+	entry.expiresMs = now + (DNS_CACHE_TTL_S * 1000UL);
+	entry.refreshAtMs = entry.expiresMs - (DNS_CACHE_REFRESH_AHEAD_S * 1000UL);
+	return true;
+}
+
+// Returns the cached address for host, looking it up only when missing or expired.
+// An expired address is still used for a while if the lookup fails.
+static bool dnsCacheResolve(const String& host, IPAddress& addr) {
+	DnsCacheEntry& entry = dnsCacheSlot(host);
+	const unsigned long now = millis();
+	if (entry.valid && (long)(entry.expiresMs - now) > 0) {
+		gDnsCacheHits++;
+		addr = entry.addr;
+		return true;
+	}
+	gDnsCacheMisses++;
+	if (!dnsCacheRefresh(entry)) {
+		if (!entry.valid || (long)(now - entry.expiresMs) > (long)(DNS_CACHE_STALE_S * 1000UL)) return false;
+		DBG_PRINT("[DNS] Lookup failed; using expired address for "); DBG_PRINTLN(entry.host.c_str());
+	}
+	addr = entry.addr;
+	return true;
+}
+
+// Milliseconds until the next cached host is due for a background lookup
+static uint32_t dnsCacheMsUntilRefresh() {
+	uint32_t wait = UINT32_MAX;
+	const unsigned long now = millis();
+	for (const auto& entry : gDnsCache) {
+		if (entry.host.isEmpty()) continue;
+		const long due = (long)(entry.refreshAtMs - now);
+		if (due <= 0) return 0;
+		if ((uint32_t)due < wait) wait = due;
+	}
+	return wait;
+}
+
+// Offline, due entries are pushed back by DNS_CACHE_RETRY_S so netTask sleeps
+// instead of waking with a zero timeout; reconnecting prefetches them anyway.
+static void dnsCacheRefreshDue() {
+	const bool online = WiFi.status() == WL_CONNECTED;
+	const unsigned long now = millis();
+	for (auto& entry : gDnsCache) {
+		if (entry.host.isEmpty() || (long)(entry.refreshAtMs - now) > 0) continue;
+		if (!online) {
+			entry.refreshAtMs = now + (DNS_CACHE_RETRY_S * 1000UL);
+			continue;
+		}
+		if (!dnsCacheRefresh(entry)) {
+			DBG_PRINT("[DNS] Background lookup failed for "); DBG_PRINTLN(entry.host.c_str());
+		}
+	}
+}
+
+static const char* httpsAuthorityOf(const char* url) {
+	const char* scheme = strstr(url, "://");
+	return scheme ? scheme + 3 : url;
+}
+
+static String httpsHostOf(const char* url) {
+	const char* start = httpsAuthorityOf(url);
+	const size_t len = strcspn(start, "/:");
+	String host;
+	host.concat(start, len);
+	return host;
+}
+
+static uint16_t httpsPortOf(const char* url) {
+	const char* start = httpsAuthorityOf(url);
+	const char* end = start + strcspn(start, "/");
+	const char* colon = (const char*)memchr(start, ':', end - start);
+	if (!colon) return 443;
+	const long port = strtol(colon + 1, nullptr, 10);
+	return (port > 0 && port <= 65535) ? (uint16_t)port : 443;
+}
+
+static HttpsConnection& acquireHttpsConnection(const String& host) {
+	const unsigned long now = millis();
+	HttpsConnection* match = nullptr;
+	HttpsConnection* victim = nullptr;
+	for (auto& conn : gHttpsPool) {
+		if (conn.host == host) {
+			match = &conn;
+			continue;
+		}
+		// Idle sockets still hold their TLS buffers; release them once stale
+		if (conn.host.length() && (now - conn.lastUsedMs) >= HTTPS_KEEPALIVE_IDLE_MS) {
+			conn.tls.stop();
+			conn.host = "";
+		}
+		if (!victim || (victim->host.length() && (conn.host.isEmpty() || conn.lastUsedMs < victim->lastUsedMs))) {
+			victim = &conn;
+		}
+	}
+	if (match) return *match;
+	victim->tls.stop();
+	victim->host = host;
+	return *victim;
+}
+
+// Returns true when the request can go out on the slot's open connection.
+static bool prepareHttpsConnection(HttpsConnection& conn, bool insecure) {
+	const bool reuse = conn.insecure == insecure &&
+		(millis() - conn.lastUsedMs) < HTTPS_KEEPALIVE_IDLE_MS &&
+		conn.tls.connected();
+	if (reuse) {
+		gHttpsReused++;
+		return true;
+	}
+	conn.tls.stop();
+#ifndef DISABLECERTCHECK
+	if (conn.insecure && !insecure) {
+		// setInsecure() cannot be undone on a WiFiClientSecure; start from a fresh one
+		conn.tls.~WiFiClientSecure();
+		new (&conn.tls) WiFiClientSecure();
+	}
+	if (insecure) {
+		conn.tls.setInsecure();
+	} else {
+		conn.tls.setCACertBundle(x509_crt_bundle);
+	}
+#else
+	conn.tls.setInsecure();
+#endif
+	conn.tls.setHandshakeTimeout(20);
+	conn.insecure = insecure;
+	gHttpsHandshakes++;
+	return false;
+}
+
+// Connects a fresh slot to the cached address ahead of HTTPClient, which then
+// finds the socket open and uses it as is. The hostname is still passed for SNI
+// and certificate checks.
+static bool openHttpsConnection(HttpsConnection& conn, uint16_t port, NetSample& sample) {
+	uint32_t startMs = millis();
+	IPAddress addr;
+	const bool resolved = dnsCacheResolve(conn.host, addr);
+	sample.setPhase(NET_PHASE_DNS, millis() - startMs);
+	if (!resolved) {
+		DBG_PRINT("[HTTPS] DNS lookup failed for "); DBG_PRINTLN(conn.host.c_str());
+		return false;
+	}
+	startMs = millis();
+	const bool connected = conn.tls.connect(addr, port, conn.host.c_str(), nullptr, nullptr, nullptr) == 1;
+	sample.setPhase(NET_PHASE_CONNECT, millis() - startMs);
+	if (!connected) {
+		// The host may have moved; look it up again on the next attempt
+		dnsCacheSlot(conn.host).expiresMs = millis();
+	}
+	return connected;
+}
+
+// Warms the cache for a base URL such as GRAPH_BASE_URL
+static void dnsCachePrefetch(const char* url) {
+	const String host = httpsHostOf(url);
+	IPAddress addr;
+	if (host.length() && !dnsCacheResolve(host, addr)) {
+		DBG_PRINT("[DNS] Prefetch failed for "); DBG_PRINTLN(host.c_str());
+	}
+}
+
+// Response filters for requestJsonApi(): keep only the fields each caller reads.
+static const JsonDocument& tokenResponseFilter() {
+	static JsonDocument filter;
+	if (filter.isNull()) {
+		filter["access_token"] = true;
+		filter["refresh_token"] = true;
+		filter["id_token"] = true;
+		filter["expires_in"] = true;
+		filter["error"] = true;
+		filter["error_description"] = true;
+	}
+	return filter;
+}
+
+static const JsonDocument& presenceResponseFilter() {
+	static JsonDocument filter;
+	if (filter.isNull()) {
+		filter["availability"] = true;
+		filter["activity"] = true;
+		filter["error"]["code"] = true;
+	}
+	return filter;
+}
+
+static const JsonDocument& presenceBatchResponseFilter() {
+	static JsonDocument filter;
+	if (filter.isNull()) {
+		filter["value"][0]["id"] = true;
+		filter["value"][0]["availability"] = true;
+		filter["value"][0]["activity"] = true;
+		filter["error"]["code"] = true;
+	}
+	return filter;
+}
+
+static const JsonDocument& deviceCodeResponseFilter() {
+	static JsonDocument filter;
+	if (filter.isNull()) {
+		filter["device_code"] = true;
+		filter["user_code"] = true;
+		filter["interval"] = true;
+		filter["verification_uri"] = true;
+		filter["verification_uri_complete"] = true;
+		filter["message"] = true;
+		filter["error"] = true;
+		filter["error_description"] = true;
+	}
+	return filter;
+}
+
+boolean requestJsonApi(JsonDocument& doc, const char* url, const char* payload = "", size_t payloadLength = 0, const char* method = "POST", const char* bearer = nullptr, const JsonDocument* filter = nullptr, const char* contentType = "application/x-www-form-urlencoded") {
 	time_t now = time(nullptr);
 	if (now < 1609459200) {
-		DBG_PRINTLN(F("[HTTPS] Time not set; syncing via NTP..."));
-		syncTime();
+		DBG_PRINTLN(F("[HTTPS] Time not set; waiting for NTP..."));
+		waitForTimeSync(TIME_SYNC_WAIT_MS);
 	}
 	extern void addLogf(const char*, ...);
+	const bool isPost = strcmp(method, "POST") == 0;
 	const bool allowInsecureRetry =
-		url.startsWith("https://login.microsoftonline.com/") ||
-		url.startsWith("https://graph.microsoft.com/");
+		strncmp(url, LOGIN_BASE_URL "/", strlen(LOGIN_BASE_URL "/")) == 0 ||
+		strncmp(url, GRAPH_BASE_URL "/", strlen(GRAPH_BASE_URL "/")) == 0;
+	HttpsConnection& conn = acquireHttpsConnection(httpsHostOf(url));
+	HTTPClient& https = conn.http;
+	WiFiClientSecure& tls = conn.tls;
+	const uint16_t port = httpsPortOf(url);
+	const NetEndpoint endpoint = NetStats::classify(url);
 
-	auto performRequest = [&](bool insecure, bool isRetry) -> bool {
-		WiFiClientSecure tls;
-#ifndef DISABLECERTCHECK
-		if (insecure) {
-			tls.setInsecure();
-		} else {
-			tls.setCACertBundle(x509_crt_bundle);
+	// Sends the request on the slot's socket; returns the HTTP status or an HTTPC_ERROR_* code
+	auto sendRequest = [&](bool reused, NetSample& sample) -> int {
+		sample.reused = reused;
+		if (!reused && !openHttpsConnection(conn, port, sample)) return HTTPC_ERROR_CONNECTION_REFUSED;
+		if (!https.begin(tls, url)) return HTTPC_ERROR_CONNECTION_REFUSED;
+		static const char* collectKeys[] = {"Retry-After"};
+		https.collectHeaders(collectKeys, 1);
+		https.setReuse(true);
+		https.setConnectTimeout(10000);
+		https.setTimeout(10000);
+		https.setFollowRedirects(HTTPC_FORCE_FOLLOW_REDIRECTS);
+		https.addHeader("Accept", "application/json");
+		if (isPost) {
+			https.addHeader("Content-Type", contentType);
 		}
-#else
-		(void)insecure;
-		tls.setInsecure();
-#endif
-		tls.setHandshakeTimeout(20);
-
-		HTTPClient https;
-		if (https.begin(tls, url)) {
-			https.setConnectTimeout(10000);
-			https.setTimeout(10000);
-			https.setFollowRedirects(HTTPC_FORCE_FOLLOW_REDIRECTS);
-			https.addHeader("Accept", "application/json");
-			if (type == "POST") {
-				https.addHeader("Content-Type", "application/x-www-form-urlencoded");
-			}
 
-			if (sendAuth) {
-				String header;
-				header.reserve(access_token.length() + 8);
-				header += F("Bearer ");
-				header += access_token;
-				https.addHeader("Authorization", header);
-				DBG_PRINT("[HTTPS] Auth token valid for "); DBG_PRINT(getTokenLifetime()); DBG_PRINTLN(" s.");
-			}
+		// HTTPClient writes "Authorization: <type> <token>" itself, so no header String is built here.
+		// The pooled client keeps the token between requests; an empty one sends no header.
+		https.setAuthorizationType("Bearer");
+		https.setAuthorization(bearer ? bearer : "");
+		if (bearer) {
+			DBG_PRINT("[HTTPS] Auth token valid for "); DBG_PRINT(getTokenLifetime()); DBG_PRINTLN(" s.");
+		}
+
+		const uint32_t startMs = millis();
+		const int httpCode = isPost
+			? https.POST(reinterpret_cast<uint8_t*>(const_cast<char*>(payload)), payloadLength)
+			: https.GET();
+		sample.setPhase(NET_PHASE_FIRST_BYTE, millis() - startMs);
+		return httpCode;
+	};
 
-			int httpCode = (type == "POST") ? https.POST(payload) : https.GET();
-			if (httpCode > 0) {
-				DBG_PRINT("[HTTPS] Method: "); DBG_PRINT(type.c_str()); DBG_PRINT(", Response code: "); DBG_PRINTLN(httpCode);
-				String body = https.getString();
-				if (body.length() > 0) {
-					DeserializationError error = deserializeJson(doc, body);
-					if (error) {
-						DBG_PRINT(F("deserializeJson() failed: "));
-						DBG_PRINTLN(error.c_str());
-						DBG_PRINT(F("[HTTPS] Raw body: "));
-						DBG_PRINTLN(body);
-						https.end();
-						return false;
-					}
-					doc["_http_status"] = httpCode;
-					if (insecure) {
-						doc["_tls_insecure_retry"] = true;
-					}
+	auto attemptRequest = [&](bool insecure, bool isRetry, NetSample& sample) -> bool {
+		const bool reused = prepareHttpsConnection(conn, insecure);
+		int httpCode = sendRequest(reused, sample);
+		if (httpCode < 0 && reused) {
+			// The server dropped the idle socket between polls; retry once on a fresh one
+			DBG_PRINTLN(F("[HTTPS] Kept-alive connection lost; reconnecting"));
+			https.end();
+			conn.lastUsedMs = 0;
+			prepareHttpsConnection(conn, insecure);
+			httpCode = sendRequest(false, sample);
+		}
+		conn.lastUsedMs = millis();
+		sample.httpStatus = httpCode;
+
+		if (httpCode > 0) {
+			DBG_PRINT("[HTTPS] Method: "); DBG_PRINT(method); DBG_PRINT(", Response code: "); DBG_PRINTLN(httpCode);
+			const uint32_t heapBefore = ESP.getFreeHeap();
+			const uint32_t parseStartMs = millis();
+			DeserializationError error;
+			const int size = https.getSize(); // -1 for chunked or unknown length
+			if (size > 0) {
+				sample.bytesIn = size;
+				// Parse straight off the socket so the body never sits in RAM as a String
+				error = filter
+					? deserializeJson(doc, https.getStream(), DeserializationOption::Filter(*filter))
+					: deserializeJson(doc, https.getStream());
+			} else {
+				// HTTPClient's stream does not de-chunk, so chunked bodies are buffered first
+				String body = (size < 0) ? https.getString() : String();
+				sample.bytesIn = body.length();
+				if (body.length() == 0) {
+					DBG_PRINT("[HTTPS] Empty response body for HTTP "); DBG_PRINTLN(httpCode);
 					https.end();
-					return true;
+					return false;
 				}
-
-				DBG_PRINT("[HTTPS] Empty response body for HTTP "); DBG_PRINTLN(httpCode);
+				error = filter
+					? deserializeJson(doc, body, DeserializationOption::Filter(*filter))
+					: deserializeJson(doc, body);
+			}
+			sample.setPhase(NET_PHASE_READ_PARSE, millis() - parseStartMs);
+			const uint32_t heapAfter = ESP.getFreeHeap();
+			DBG_PRINT("[HTTPS] Heap free before/after parse: "); DBG_PRINT(heapBefore); DBG_PRINT(" / "); DBG_PRINT(heapAfter);
+			DBG_PRINT(" (delta "); DBG_PRINT((int32_t)(heapBefore - heapAfter)); DBG_PRINTLN(")");
+			if (error) {
+				DBG_PRINT(F("deserializeJson() failed: "));
+				DBG_PRINTLN(error.c_str());
 				https.end();
+				tls.stop(); // unread body bytes would corrupt the next request on this socket
 				return false;
 			}
-
-			DBG_PRINT("[HTTPS] Request failed: "); DBG_PRINTLN(https.errorToString(httpCode).c_str());
-			char tlsError[128] = {0};
-			int tlsCode = tls.lastError(tlsError, sizeof(tlsError));
-			if (tlsCode != 0) {
-				DBG_PRINT("[HTTPS] TLS error: "); DBG_PRINT(tlsCode); DBG_PRINT(" ");
-				DBG_PRINTLN(tlsError);
-				addLogf("HTTPS request failed%s: %d (%s), TLS %d: %s",
-					isRetry ? " [retry]" : "",
-					httpCode,
-					https.errorToString(httpCode).c_str(),
-					tlsCode,
-					tlsError);
-			} else {
-				addLogf("HTTPS request failed%s: %d (%s)",
-					isRetry ? " [retry]" : "",
-					httpCode,
-					https.errorToString(httpCode).c_str());
+			doc["_http_status"] = httpCode;
+			if (https.hasHeader("Retry-After")) {
+				doc["_retry_after"] = https.header("Retry-After").toInt(); // HTTP-date form reads as 0
+			}
+			if (insecure) {
+				doc["_tls_insecure_retry"] = true;
 			}
 			https.end();
-			return false;
+			return true;
 		}
 
-		DBG_PRINTLN(F("[HTTPS] Unable to connect"));
+		DBG_PRINT("[HTTPS] Request failed: "); DBG_PRINTLN(https.errorToString(httpCode).c_str());
+		char tlsError[128] = {0};
+		int tlsCode = tls.lastError(tlsError, sizeof(tlsError));
+		if (tlsCode != 0) {
+			DBG_PRINT("[HTTPS] TLS error: "); DBG_PRINT(tlsCode); DBG_PRINT(" ");
+			DBG_PRINTLN(tlsError);
+			addLogf("HTTPS request failed%s: %d (%s), TLS %d: %s",
+				isRetry ? " [retry]" : "",
+				httpCode,
+				https.errorToString(httpCode).c_str(),
+				tlsCode,
+				tlsError);
+		} else {
+			addLogf("HTTPS request failed%s: %d (%s)",
+				isRetry ? " [retry]" : "",
+				httpCode,
+				https.errorToString(httpCode).c_str());
+		}
+		https.end();
+		tls.stop();
 		return false;
 	};
 
+	auto performRequest = [&](bool insecure, bool isRetry) -> bool {
+		NetSample sample;
+		sample.bytesOut = isPost ? payloadLength : 0;
+		sample.insecureRetry = insecure && isRetry;
+		const uint32_t startMs = millis();
+		sample.ok = attemptRequest(insecure, isRetry, sample);
+		sample.setPhase(NET_PHASE_TOTAL, millis() - startMs);
+		gNetStats.record(endpoint, sample);
+		return sample.ok;
+	};
+
 #ifndef DISABLECERTCHECK
 	bool success = performRequest(false, false);
 	if (!success && allowInsecureRetry) {
@@ -130,32 +443,6 @@ static inline String htmlEscape(const String& in) {
 	return out;
 }
 
-static inline bool isFormSafeChar(char c) {
-	return (c >= 'A' && c <= 'Z') ||
-		(c >= 'a' && c <= 'z') ||
-		(c >= '0' && c <= '9') ||
-		c == '-' || c == '_' || c == '.' || c == '~';
-}
-
-static inline String urlEncodeFormValue(const String& in) {
-	static const char hex[] = "0123456789ABCDEF";
-	String out;
-	out.reserve((in.length() * 3) + 1);
-	for (size_t i = 0; i < in.length(); ++i) {
-		unsigned char c = (unsigned char)in.charAt(i);
-		if (isFormSafeChar((char)c)) {
-			out += (char)c;
-		} else if (c == ' ') {
-			out += '+';
-		} else {
-			out += '%';
-			out += hex[(c >> 4) & 0x0F];
-			out += hex[c & 0x0F];
-		}
-	}
-	return out;
-}
-
 void handleGetSettings() {
 	DBG_PRINTLN("handleGetSettings()");
 
@@ -169,8 +456,12 @@ void handleGetSettings() {
 	responseDoc["heap"].set(ESP.getFreeHeap());
 	responseDoc["heap_total"].set(ESP.getHeapSize());
 	responseDoc["min_heap"].set(ESP.getMinFreeHeap());
+	responseDoc["heap_max_block"].set(ESP.getMaxAllocHeap()); // shrinks as the heap fragments
 	responseDoc["sketch_size"].set(ESP.getSketchSize());
 	responseDoc["free_sketch_space"].set(ESP.getFreeSketchSpace());
+	responseDoc["ui_source"].set(gUiBundle.active() ? "partition" : "embedded");
+	responseDoc["ui_bundle_size"].set(gUiBundle.size());
+	responseDoc["ui_bundle_capacity"].set(gUiBundle.partitionSize());
 	responseDoc["flash_chip_size"].set(ESP.getFlashChipSize());
 	responseDoc["flash_chip_speed"].set(ESP.getFlashChipSpeed());
 	responseDoc["sdk_version"].set(ESP.getSdkVersion());
@@ -189,6 +480,21 @@ void handleGetSettings() {
 	responseDoc["host_local"].set(String(gThingHostName) + ".local");
 	extern uint8_t getCpuUsagePercent();
 	responseDoc["cpu_usage"].set(getCpuUsagePercent());
+	// Rendered frames include ones skipped because they matched what the strip shows
+	responseDoc["led_frames_rendered"].set(effects.getFramesRendered());
+	responseDoc["led_frames_shown"].set(effects.getFrameCount());
+	responseDoc["https_handshakes"].set(gHttpsHandshakes);
+	responseDoc["https_reused"].set(gHttpsReused);
+	extern void fillPresencePollJson(JsonDocument& doc);
+	fillPresencePollJson(responseDoc);
+	JsonArray presenceUsers = responseDoc["presence_users"].to<JsonArray>();
+	for (uint8_t i = 0; i < gPresenceUserCount; ++i) {
+		JsonObject u = presenceUsers.add<JsonObject>();
+		u["id"] = gPresenceUsers[i].id;
+		u["availability"] = gPresenceUsers[i].availability;
+		u["activity"] = gPresenceUsers[i].activity;
+	}
+	responseDoc["presence_layout"] = (gPresenceLayout == PRESENCE_LAYOUT_SEGMENTS) ? "segments" : "aggregate";
 	responseDoc["sketch_version"].set(VERSION);
 	time_t now = time(nullptr);
 	if (now >= 1609459200) {
@@ -216,6 +522,64 @@ void handleGetSettings() {
 	sendJsonDocument(200, responseDoc);
 }
 
+void handleGetNetStats() {
+	DBG_PRINTLN("handleGetNetStats()");
+	// Copied out under the stats lock; static because it is ~2 KB and only the web task runs this
+	static NetEndpointStats snapshot[NET_EP_COUNT];
+	gNetStats.snapshot(snapshot);
+
+	JsonDocument responseDoc;
+	responseDoc["uptime_ms"].set(millis());
+	responseDoc["https_handshakes"].set(gHttpsHandshakes);
+	responseDoc["https_reused"].set(gHttpsReused);
+	responseDoc["dns_cache_hits"].set(gDnsCacheHits);
+	responseDoc["dns_cache_misses"].set(gDnsCacheMisses);
+	JsonArray bucketMs = responseDoc["bucket_ms"].to<JsonArray>();
+	for (uint16_t bound : kNetStatsBucketMs) bucketMs.add(bound);
+
+	JsonObject endpoints = responseDoc["endpoints"].to<JsonObject>();
+	for (uint8_t ep = 0; ep < NET_EP_COUNT; ++ep) {
+		const NetEndpointStats& st = snapshot[ep];
+		if (st.requests == 0) continue;
+		JsonObject e = endpoints[NetStats::endpointName(ep)].to<JsonObject>();
+		e["requests"] = st.requests;
+		e["failures"] = st.failures;
+		e["reused"] = st.reused;
+		e["insecure_retries"] = st.insecureRetries;
+		e["bytes_out"] = st.bytesOut;
+		e["bytes_in"] = st.bytesIn;
+		JsonObject status = e["status"].to<JsonObject>();
+		status["2xx"] = st.status2xx;
+		status["4xx"] = st.status4xx;
+		status["5xx"] = st.status5xx;
+		status["error"] = st.statusError;
+		JsonObject phases = e["phases"].to<JsonObject>();
+		for (uint8_t p = 0; p < NET_PHASE_COUNT; ++p) {
+			const NetPhaseStats& ph = st.phases[p];
+			if (ph.count == 0) continue;
+			JsonObject o = phases[NetStats::phaseName(p)].to<JsonObject>();
+			o["count"] = ph.count;
+			o["avg_ms"] = ph.sumMs / ph.count;
+			o["max_ms"] = ph.maxMs;
+			JsonArray hist = o["hist"].to<JsonArray>();
+			for (uint8_t b = 0; b < NET_STATS_BUCKETS; ++b) hist.add(ph.hist[b]);
+		}
+		JsonObject last = e["last"].to<JsonObject>();
+		last["ok"] = st.last.ok;
+		last["http_status"] = st.last.httpStatus;
+		last["reused"] = st.last.reused;
+		last["insecure_retry"] = st.last.insecureRetry;
+		last["bytes_out"] = st.last.bytesOut;
+		last["bytes_in"] = st.last.bytesIn;
+		for (uint8_t p = 0; p < NET_PHASE_COUNT; ++p) {
+			if (!st.last.phaseSeen[p]) continue;
+			last[String(NetStats::phaseName(p)) + "_ms"] = st.last.phaseMs[p];
+		}
+	}
+
+	sendJsonDocument(200, responseDoc);
+}
+
 void handleClearSettings() {
 	DBG_PRINTLN("handleClearSettings()");
 	memset(paramClientIdValue, 0, sizeof(paramClientIdValue));
@@ -234,7 +598,85 @@ void handleClearSettings() {
 	ESP.restart();
 }
 
+// Applied on appTask when the device-code request finishes on the network task
+void handleDeviceCodeResult(NetJob& job) {
+	JsonDocument& doc = job.response;
+	JsonDocument& responseDoc = gDeviceLoginStartJob.response;
+	responseDoc.clear();
+	gDeviceLoginStartJob.state = ASYNC_JOB_FAILED;
+	gDeviceLoginStartJob.completedAtMs = millis();
+	// Auth was reset, its settings changed or a login finished while this was in flight
+	if (job.authGeneration != gAuthGeneration) {
+		addLog("Device login start superseded; result dropped");
+		responseDoc["ok"] = false;
+		responseDoc["error"] = "devicelogin_superseded";
+		responseDoc["message"] = "The sign-in settings changed while device login was starting; start it again.";
+		gDeviceLoginStartJob.httpStatus = 409;
+		return;
+	}
+	if (job.ok && !doc["device_code"].isNull() && !doc["user_code"].isNull() && !doc["interval"].isNull() &&
+		!doc["verification_uri"].isNull() && !doc["message"].isNull()) {
+		device_code = doc["device_code"].as<String>();
+		user_code = doc["user_code"].as<String>();
+		device_login_verification_uri = doc["verification_uri"].as<String>();
+		device_login_verification_uri_complete = doc["verification_uri_complete"].isNull() ? "" : doc["verification_uri_complete"].as<String>();
+		device_login_message = doc["message"].as<String>();
+		interval = doc["interval"].as<unsigned int>();
+
+		responseDoc["user_code"] = user_code;
+		responseDoc["verification_uri"] = device_login_verification_uri;
+		if (device_login_verification_uri_complete.length()) {
+			responseDoc["verification_uri_complete"] = device_login_verification_uri_complete;
+		}
+		responseDoc["message"] = device_login_message;
+		gDeviceLoginTransientFailures = 0;
+		state = SMODEDEVICELOGINSTARTED;
+		tsPolling = millis() + (interval * 1000);
+		gDeviceLoginStartJob.state = ASYNC_JOB_SUCCESS;
+		gDeviceLoginStartJob.httpStatus = 200;
+	} else if (job.ok && !doc["error"].isNull()) {
+		responseDoc["ok"] = false;
+		responseDoc["error"] = doc["error"].as<String>();
+		if (!doc["error_description"].isNull()) {
+			responseDoc["message"] = doc["error_description"].as<String>();
+		} else if (!doc["message"].isNull()) {
+			responseDoc["message"] = doc["message"].as<String>();
+		}
+		gDeviceLoginStartJob.httpStatus = 400;
+	} else {
+		String detail = "Microsoft device login did not return a usable device code response.";
+		if (!doc["_http_status"].isNull()) {
+			detail += " HTTP ";
+			detail += doc["_http_status"].as<int>();
+			detail += ".";
+		}
+		addLogf("Device login start failed: %s", detail.c_str());
+		responseDoc["ok"] = false;
+		responseDoc["error"] = "devicelogin_unknown_response";
+		responseDoc["message"] = detail;
+		gDeviceLoginStartJob.httpStatus = 502;
+	}
+}
+
+// Starts the device-code request in the background; the UI polls this endpoint
+// (202 + pending) until the outcome is available.
 void handleStartDevicelogin() {
+	if (gDeviceLoginStartJob.state == ASYNC_JOB_SUCCESS || gDeviceLoginStartJob.state == ASYNC_JOB_FAILED) {
+		// Only the client still polling for this start should get its outcome; a result
+		// nobody collected in time is dropped and the request below is handled afresh
+		const bool fresh = millis() - gDeviceLoginStartJob.completedAtMs < (DEVICE_LOGIN_RESULT_TTL_S * 1000UL);
+		if (fresh) sendJsonDocument(gDeviceLoginStartJob.httpStatus, gDeviceLoginStartJob.response);
+		gDeviceLoginStartJob.state = ASYNC_JOB_IDLE;
+		gDeviceLoginStartJob.response.clear();
+		if (fresh) return;
+	}
+	if (gDeviceLoginStartJob.state == ASYNC_JOB_RUNNING) {
+		JsonDocument responseDoc;
+		responseDoc["ok"] = true;
+		responseDoc["pending"] = true;
+		sendJsonDocument(202, responseDoc);
+		return;
+	}
 	if (state != SMODEDEVICELOGINSTARTED) {
 		DBG_PRINTLN(F("handleStartDevicelogin()"));
 		String clientId = String(paramClientIdValue);
@@ -249,60 +691,30 @@ void handleStartDevicelogin() {
 			sendApiError(400, "missing_tenant", "Set and save the Microsoft tenant before starting device login.");
 			return;
 		}
-		JsonDocument doc;
-		String payload;
-		String encodedClientId = urlEncodeFormValue(clientId);
-		payload.reserve(encodedClientId.length() + 96);
-		payload += F("client_id=");
-		payload += encodedClientId;
-		payload += F("&scope=offline_access%20openid%20Presence.Read");
-		boolean res = requestJsonApi(
-			doc,
-			"https://login.microsoftonline.com/" + tenant + "/oauth2/v2.0/devicecode",
-			payload,
-			0
-		);
-
-		if (res && !doc["device_code"].isNull() && !doc["user_code"].isNull() && !doc["interval"].isNull() &&
-			!doc["verification_uri"].isNull() && !doc["message"].isNull()) {
-			device_code = doc["device_code"].as<String>();
-			user_code = doc["user_code"].as<String>();
-			device_login_verification_uri = doc["verification_uri"].as<String>();
-			device_login_verification_uri_complete = doc["verification_uri_complete"].isNull() ? "" : doc["verification_uri_complete"].as<String>();
-			device_login_message = doc["message"].as<String>();
-			interval = doc["interval"].as<unsigned int>();
-
-			JsonDocument responseDoc;
-			responseDoc["user_code"] = user_code;
-			responseDoc["verification_uri"] = device_login_verification_uri;
-			if (device_login_verification_uri_complete.length()) {
-				responseDoc["verification_uri_complete"] = device_login_verification_uri_complete;
-			}
-			responseDoc["message"] = device_login_message;
-			gDeviceLoginTransientFailures = 0;
-			state = SMODEDEVICELOGINSTARTED;
-			tsPolling = millis() + (interval * 1000);
-			sendJsonDocument(200, responseDoc);
-		} else if (res && !doc["error"].isNull()) {
-			JsonDocument responseDoc;
-			responseDoc["ok"] = false;
-			responseDoc["error"] = doc["error"].as<String>();
-			if (!doc["error_description"].isNull()) {
-				responseDoc["message"] = doc["error_description"].as<String>();
-			} else if (!doc["message"].isNull()) {
-				responseDoc["message"] = doc["message"].as<String>();
-			}
-			sendJsonDocument(400, responseDoc);
-		} else {
-			String detail = "Microsoft device login did not return a usable device code response.";
-			if (!doc["_http_status"].isNull()) {
-				detail += " HTTP ";
-				detail += doc["_http_status"].as<int>();
-				detail += ".";
-			}
-			addLogf("Device login start failed: %s", detail.c_str());
-			sendApiError(502, "devicelogin_unknown_response", detail.c_str());
+		NetJob* job = new NetJob();
+		job->type = NET_JOB_DEVICE_CODE;
+		job->url.append(LOGIN_BASE_URL "/").append(tenant).append("/oauth2/v2.0/devicecode");
+		job->payload.formField("client_id", clientId);
+		// Reading other users' presence needs the broader scope, granted at login
+		job->payload.formField("scope", (gPresenceUserCount > 0)
+			? "offline_access openid Presence.Read Presence.Read.All"
+			: "offline_access openid Presence.Read");
+		job->filter = &deviceCodeResponseFilter();
+		job->authGeneration = gAuthGeneration;
+		if (job->url.overflowed() || job->payload.overflowed()) {
+			delete job;
+			sendApiError(400, "request_too_long", "The tenant or Client ID is too long.");
+			return;
+		}
+		if (!postNetJob(job)) {
+			sendApiError(503, "network_busy", "The device is busy with another Microsoft request; try again.");
+			return;
 		}
+		gDeviceLoginStartJob.state = ASYNC_JOB_RUNNING;
+		JsonDocument responseDoc;
+		responseDoc["ok"] = true;
+		responseDoc["pending"] = true;
+		sendJsonDocument(202, responseDoc);
 	} else {
 		JsonDocument responseDoc;
 		responseDoc["ok"] = false;
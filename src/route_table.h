@@ -0,0 +1,79 @@
+// Exact-path route table for WebServer.
+//
+// WebServer keeps one heap-allocated handler per server.on() and asks each of
+// them in turn whether it matches, copying the URI into a new String for every
+// call. RouteTable is a single RequestHandler holding all exact routes in an
+// array kept sorted by path, so a request costs one binary search.
+// Routes for the same path keep their registration order, which is the order
+// WebServer would have tried them in.
+
+#pragma once
+#include <Arduino.h>
+#include <WebServer.h>
+
+template<size_t N>
+class RouteTable : public RequestHandler {
+public:
+  // uri is kept, not copied, so it must be a literal. False when the table is
+  // full; the caller should register the route with WebServer instead.
+  bool add(const char* uri, HTTPMethod method, WebServer::THandlerFunction fn, WebServer::THandlerFunction ufn) {
+    if (_count >= N) return false;
+    // Insert after every route that sorts at or before uri
+    size_t pos = _count;
+    while (pos > 0 && strcmp(_routes[pos - 1].uri, uri) > 0) {
+      _routes[pos] = _routes[pos - 1];
+      --pos;
+    }
+    _routes[pos] = Route{ uri, method, fn, ufn };
+    ++_count;
+    return true;
+  }
+
+  size_t size() const { return _count; }
+
+  bool canHandle(HTTPMethod method, String uri) override {
+    return find(uri.c_str(), method) != nullptr;
+  }
+
+  bool canUpload(String uri) override {
+    const Route* route = find(uri.c_str(), HTTP_POST);
+    return route && route->ufn;
+  }
+
+  bool handle(WebServer& server, HTTPMethod method, String uri) override {
+    const Route* route = find(uri.c_str(), method);
+    if (!route) return false;
+    route->fn();
+    return true;
+  }
+
+  void upload(WebServer& server, String uri, HTTPUpload& upload) override {
+    const Route* route = find(uri.c_str(), HTTP_POST);
+    if (route && route->ufn) route->ufn();
+  }
+
+private:
+  struct Route {
+    const char* uri;
+    HTTPMethod method;
+    WebServer::THandlerFunction fn;
+    WebServer::THandlerFunction ufn;
+  };
+
+  // First registered route for uri that accepts method
+  const Route* find(const char* uri, HTTPMethod method) const {
+    size_t lo = 0, hi = _count;
+    while (lo < hi) {
+      const size_t mid = lo + (hi - lo) / 2;
+      if (strcmp(_routes[mid].uri, uri) < 0) lo = mid + 1; else hi = mid;
+    }
+    for (size_t i = lo; i < _count && strcmp(_routes[i].uri, uri) == 0; ++i) {
+      const Route& route = _routes[i];
+      if (route.method == HTTP_ANY || route.method == method) return &route;
+    }
+    return nullptr;
+  }
+
+  Route _routes[N];
+  size_t _count = 0;
+};
@@ -0,0 +1,225 @@
+// Web UI asset bundle kept in its own flash partition.
+//
+// scripts/embed_assets.py writes the same assets it embeds into ui_bundle.bin.
+// When the partition table has a UI_BUNDLE_PARTITION_LABEL data partition
+// holding a valid bundle, it is memory-mapped and its index is turned into
+// EmbeddedAsset records whose pointers go straight into flash, so
+// serveEmbeddedAsset() serves it exactly like the compiled-in assets. Without
+// the partition, or while it is being rewritten, the embedded assets are used.
+//
+// Layout (little endian): UiBundleHeader, `count` UiBundleEntry records, then
+// NUL-terminated strings and asset data. Offsets are from the bundle start;
+// 0 means absent. The CRC-32 covers everything after the header.
+
+#pragma once
+#include <Arduino.h>
+#include <algorithm>
+#include <esp_partition.h>
+#include <esp_idf_version.h>
+#include <esp_rom_crc.h>
+#include "config.h"
+#include "generated/embedded_assets.h"
+
+#define UI_BUNDLE_MAGIC 0x49554753u // "SGUI"
+#define UI_BUNDLE_VERSION 1
+
+struct UiBundleHeader {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t count;
+  uint32_t totalSize;
+  uint32_t crc32;
+};
+
+struct UiBundleEntry {
+  uint32_t path;
+  uint32_t contentType;
+  uint32_t hashedPath;
+  uint32_t etag;
+  uint32_t gzipEtag;
+  uint32_t brEtag;
+  uint32_t rawOffset;
+  uint32_t rawLength;
+  uint32_t gzipOffset;
+  uint32_t gzipLength;
+  uint32_t brOffset;
+  uint32_t brLength;
+  uint32_t flags; // bit 0: public asset
+};
+
+static_assert(sizeof(UiBundleHeader) == 16, "bundle header layout is shared with embed_assets.py");
+static_assert(sizeof(UiBundleEntry) == 52, "bundle entry layout is shared with embed_assets.py");
+
+class UiBundle {
+public:
+  // Maps and validates the bundle; false leaves the embedded assets in use
+  bool begin() {
+    unmap();
+    _partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+      (esp_partition_subtype_t)UI_BUNDLE_PARTITION_SUBTYPE, UI_BUNDLE_PARTITION_LABEL);
+    if (!_partition) return false;
+    UiBundleHeader header;
+    if (esp_partition_read(_partition, 0, &header, sizeof(header)) != ESP_OK) return false;
+    if (header.magic != UI_BUNDLE_MAGIC || header.version != UI_BUNDLE_VERSION) return false;
+    const size_t indexEnd = sizeof(header) + (size_t)header.count * sizeof(UiBundleEntry);
+    if (header.count == 0 || header.totalSize < indexEnd || header.totalSize > _partition->size) return false;
+    if (esp_partition_mmap(_partition, 0, header.totalSize, kMmapData, &_base, &_handle) != ESP_OK) {
+      _base = nullptr;
+      return false;
+    }
+    const uint8_t* bytes = static_cast<const uint8_t*>(_base);
+    const uint32_t crc = esp_rom_crc32_le(0, bytes + sizeof(header), header.totalSize - sizeof(header));
+    if (crc != header.crc32 || !buildIndex(header)) {
+      unmap();
+      return false;
+    }
+    return true;
+  }
+
+  bool active() const { return _assets != nullptr; }
+  const EmbeddedAsset* assets() const { return _assets; }
+  size_t count() const { return _count; }
+  // Sorted like kEmbeddedAssetRoutes, built once when the bundle is mapped
+  const EmbeddedAssetRoute* routes() const { return _routes; }
+  size_t routeCount() const { return _routeCount; }
+  size_t size() const { return _size; }
+  size_t partitionSize() const { return _partition ? _partition->size : 0; }
+  bool hasPartition() const { return _partition != nullptr; }
+
+  // Upload path: the mapping is dropped first, so requests fall back to the
+  // embedded assets until endWrite() has validated the new bundle.
+  bool beginWrite() {
+    unmap();
+    if (!_partition) {
+      _partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+        (esp_partition_subtype_t)UI_BUNDLE_PARTITION_SUBTYPE, UI_BUNDLE_PARTITION_LABEL);
+    }
+    _writeOffset = 0;
+    _erasedTo = 0;
+    _writeFailed = (_partition == nullptr);
+    return !_writeFailed;
+  }
+
+  bool write(const uint8_t* data, size_t len) {
+    if (_writeFailed) return false;
+    if (_writeOffset + len > _partition->size) {
+      _writeFailed = true;
+      return false;
+    }
+    // Erase sector by sector just ahead of the data instead of the whole partition up front
+    while (_erasedTo < _writeOffset + len) {
+      if (esp_partition_erase_range(_partition, _erasedTo, SPI_FLASH_SEC_SIZE) != ESP_OK) {
+        _writeFailed = true;
+        return false;
+      }
+      _erasedTo += SPI_FLASH_SEC_SIZE;
+    }
+    if (esp_partition_write(_partition, _writeOffset, data, len) != ESP_OK) {
+      _writeFailed = true;
+      return false;
+    }
+    _writeOffset += len;
+    return true;
+  }
+
+  bool endWrite() { return !_writeFailed && begin(); }
+  size_t written() const { return _writeOffset; }
+  bool writeFailed() const { return _writeFailed; }
+
+private:
+#if ESP_IDF_VERSION_MAJOR >= 5
+  static constexpr esp_partition_mmap_memory_t kMmapData = ESP_PARTITION_MMAP_DATA;
+  esp_partition_mmap_handle_t _handle = 0;
+#else
+  static constexpr spi_flash_mmap_memory_t kMmapData = SPI_FLASH_MMAP_DATA;
+  spi_flash_mmap_handle_t _handle = 0;
+#endif
+
+  const char* stringAt(uint32_t offset) const {
+    if (offset == 0 || offset >= _size) return nullptr;
+    const char* s = static_cast<const char*>(_base) + offset;
+    return memchr(s, '\0', _size - offset) ? s : nullptr;
+  }
+
+  const uint8_t* dataAt(uint32_t offset, uint32_t length) const {
+    if (offset == 0 || length == 0 || offset > _size || length > _size - offset) return nullptr;
+    return static_cast<const uint8_t*>(_base) + offset;
+  }
+
+  bool buildIndex(const UiBundleHeader& header) {
+    _size = header.totalSize;
+    const UiBundleEntry* entries = reinterpret_cast<const UiBundleEntry*>(
+      static_cast<const uint8_t*>(_base) + sizeof(UiBundleHeader));
+    EmbeddedAsset* assets = new (std::nothrow) EmbeddedAsset[header.count];
+    EmbeddedAssetRoute* routes = new (std::nothrow) EmbeddedAssetRoute[header.count * 2];
+    if (!assets || !routes) {
+      delete[] assets;
+      delete[] routes;
+      return false;
+    }
+    size_t routeCount = 0;
+    for (uint16_t i = 0; i < header.count; ++i) {
+      const UiBundleEntry& e = entries[i];
+      EmbeddedAsset& a = assets[i];
+      a.path = stringAt(e.path);
+      a.contentType = stringAt(e.contentType);
+      a.rawData = dataAt(e.rawOffset, e.rawLength);
+      a.rawLength = a.rawData ? e.rawLength : 0;
+      a.gzipData = dataAt(e.gzipOffset, e.gzipLength);
+      a.gzipLength = a.gzipData ? e.gzipLength : 0;
+      a.publicAsset = (e.flags & 1u) != 0;
+      a.hashedPath = stringAt(e.hashedPath);
+      a.etag = stringAt(e.etag);
+      a.gzipEtag = stringAt(e.gzipEtag);
+      a.brData = dataAt(e.brOffset, e.brLength);
+      a.brLength = a.brData ? e.brLength : 0;
+      a.brEtag = stringAt(e.brEtag);
+      const bool gzipOk = !a.gzipData || a.gzipEtag;
+      const bool brOk = !a.brData || a.brEtag;
+      if (!a.path || !a.contentType || !a.etag || (!a.rawData && !a.gzipData) || !gzipOk || !brOk) {
+        delete[] assets;
+        delete[] routes;
+        return false;
+      }
+      routes[routeCount++] = { a.path, i, false };
+      if (a.hashedPath) routes[routeCount++] = { a.hashedPath, i, true };
+    }
+    std::sort(routes, routes + routeCount, [](const EmbeddedAssetRoute& x, const EmbeddedAssetRoute& y) {
+      return strcmp(x.path, y.path) < 0;
+    });
+    _assets = assets;
+    _count = header.count;
+    _routes = routes;
+    _routeCount = routeCount;
+    return true;
+  }
+
+  void unmap() {
+    delete[] _assets;
+    _assets = nullptr;
+    _count = 0;
+    delete[] _routes;
+    _routes = nullptr;
+    _routeCount = 0;
+    _size = 0;
+    if (_base) {
+#if ESP_IDF_VERSION_MAJOR >= 5
+      esp_partition_munmap(_handle);
+#else
+      spi_flash_munmap(_handle);
+#endif
+      _base = nullptr;
+    }
+  }
+
+  const esp_partition_t* _partition = nullptr;
+  const void* _base = nullptr;
+  EmbeddedAsset* _assets = nullptr;
+  size_t _count = 0;
+  EmbeddedAssetRoute* _routes = nullptr;
+  size_t _routeCount = 0;
+  size_t _size = 0;
+  size_t _writeOffset = 0;
+  size_t _erasedTo = 0;
+  bool _writeFailed = false;
+};
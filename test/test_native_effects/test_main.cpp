@@ -0,0 +1,264 @@
+// Host unit tests for the LedEffects engine. Run with: pio test -e native
+//
+// Colour scaling and the gamma/brightness tables are checked through static
+// segments, whose pixels are the scaled colour itself. The golden test replays
+// the same cases as bench/bench_effects.cpp against bench/golden_frames.txt.
+
+#include <Arduino.h>
+#include <math.h>
+#include <unity.h>
+#include "led_effects.h"
+#include "golden_replay.h"
+
+static const uint16_t kLeds = 16;
+
+// Fresh engine on the virtual clock with gamma 1.0 and full brightness, so a
+// static colour reaches the strip unchanged unless a test says otherwise
+static void resetEngine(LedEffects& fx, uint8_t bri = 255, float gamma = 1.0f) {
+  native_shim::setMillis(0);
+  randomSeed(1);
+  fx.init();
+  fx.setBrightness(bri);
+  fx.setGamma(gamma);
+}
+
+static void fillStatic(LedEffects& fx, uint8_t segment, uint16_t start, uint16_t end, uint32_t color) {
+  fx.setSegment(segment, start, end, FX_MODE_STATIC, color, 3000, false);
+  fx.service();
+}
+
+// Same arithmetic as the engine's tables: gamma over the brightness, then 16.16 scaling
+static uint8_t expectedChannel(uint8_t ch, uint8_t bri, float gamma) {
+  const float x = (float)bri / 255.0f;
+  const uint32_t k = (uint32_t)(powf(x, gamma) * 65535.0f + 0.5f);
+  return (uint8_t)((ch * k + 0x8000u) >> 16);
+}
+
+static void assertRange(const LedEffects& fx, uint16_t from, uint16_t to, uint32_t color) {
+  for (uint16_t i = from; i < to; ++i) {
+    TEST_ASSERT_EQUAL_HEX32_MESSAGE(color, fx.strip.getPixelColor(i), ("pixel " + std::to_string(i)).c_str());
+  }
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_scale_color_identity_at_full_brightness() {
+  LedEffects fx(kLeds, 0, NEO_GRB + NEO_KHZ800);
+  resetEngine(fx);
+  fillStatic(fx, 0, 0, kLeds, 0x123456);
+  assertRange(fx, 0, kLeds, 0x123456);
+}
+
+void test_scale_color_follows_gamma_curve() {
+  LedEffects fx(kLeds, 0, NEO_GRB + NEO_KHZ800);
+  const uint8_t bri = 128;
+  const float gamma = 2.2f;
+  resetEngine(fx, bri, gamma);
+  fillStatic(fx, 0, 0, kLeds, 0xFF8040);
+  const uint32_t expected = LedEffects::Color(
+    expectedChannel(0xFF, bri, gamma), expectedChannel(0x80, bri, gamma), expectedChannel(0x40, bri, gamma));
+  assertRange(fx, 0, kLeds, expected);
+}
+
+void test_gamma_lut_is_monotonic_over_brightness() {
+  LedEffects fx(kLeds, 0, NEO_GRB + NEO_KHZ800);
+  uint32_t previous = 0;
+  for (uint16_t bri = 0; bri <= 255; ++bri) {
+    resetEngine(fx, (uint8_t)bri, 2.2f);
+    fillStatic(fx, 0, 0, kLeds, WHITE);
+    const uint32_t level = fx.strip.getPixelColor(0) & 0xFF;
+    TEST_ASSERT_EQUAL_UINT32(expectedChannel(0xFF, (uint8_t)bri, 2.2f), level);
+    TEST_ASSERT_TRUE(level >= previous);
+    previous = level;
+  }
+  TEST_ASSERT_EQUAL_UINT32(0xFF, previous);
+}
+
+void test_zero_brightness_is_black() {
+  LedEffects fx(kLeds, 0, NEO_GRB + NEO_KHZ800);
+  resetEngine(fx, 0, 2.2f);
+  fillStatic(fx, 0, 0, kLeds, WHITE);
+  assertRange(fx, 0, kLeds, 0);
+}
+
+void test_segment_covers_only_its_range() {
+  LedEffects fx(kLeds, 0, NEO_GRB + NEO_KHZ800);
+  resetEngine(fx);
+  fillStatic(fx, 0, 4, 10, GREEN);
+  assertRange(fx, 0, 4, 0);
+  assertRange(fx, 4, 10, GREEN);
+  assertRange(fx, 10, kLeds, 0);
+}
+
+void test_segment_end_is_clipped_to_strip() {
+  LedEffects fx(kLeds, 0, NEO_GRB + NEO_KHZ800);
+  resetEngine(fx);
+  fillStatic(fx, 0, 10, 500, BLUE);
+  assertRange(fx, 0, 10, 0);
+  assertRange(fx, 10, kLeds, BLUE);
+}
+
+void test_segment_start_past_end_is_empty() {
+  LedEffects fx(kLeds, 0, NEO_GRB + NEO_KHZ800);
+  resetEngine(fx);
+  fillStatic(fx, 0, 12, 5, RED);
+  assertRange(fx, 0, kLeds, 0);
+}
+
+void test_segment_index_out_of_range_is_ignored() {
+  LedEffects fx(kLeds, 0, NEO_GRB + NEO_KHZ800);
+  resetEngine(fx);
+  fillStatic(fx, 0, 0, kLeds, RED);
+  fillStatic(fx, LED_EFFECTS_MAX_SEGMENTS, 0, kLeds, BLUE);
+  TEST_ASSERT_FALSE(fx.isSegmentActive(LED_EFFECTS_MAX_SEGMENTS));
+  assertRange(fx, 0, kLeds, RED);
+}
+
+void test_segments_clip_after_strip_shrinks() {
+  LedEffects fx(kLeds, 0, NEO_GRB + NEO_KHZ800);
+  resetEngine(fx);
+  fillStatic(fx, 0, 0, kLeds, RED);
+  fx.setLength(8);
+  fx.service();
+  TEST_ASSERT_EQUAL_UINT16(8, fx.strip.numPixels());
+  assertRange(fx, 0, 8, RED);
+}
+
+void test_blend_replace_overwrites_lower_layer() {
+  LedEffects fx(kLeds, 0, NEO_GRB + NEO_KHZ800);
+  resetEngine(fx);
+  fillStatic(fx, 0, 0, kLeds, RED);
+  fx.setSegmentBlend(1, SEG_BLEND_REPLACE);
+  fillStatic(fx, 1, 4, 8, BLUE);
+  assertRange(fx, 0, 4, RED);
+  assertRange(fx, 4, 8, BLUE);
+  assertRange(fx, 8, kLeds, RED);
+}
+
+void test_blend_add_saturates() {
+  LedEffects fx(kLeds, 0, NEO_GRB + NEO_KHZ800);
+  resetEngine(fx);
+  fillStatic(fx, 0, 0, kLeds, 0x80C000);
+  fx.setSegmentBlend(1, SEG_BLEND_ADD);
+  fillStatic(fx, 1, 4, 8, 0x9020FF);
+  assertRange(fx, 0, 4, 0x80C000);
+  assertRange(fx, 4, 8, 0xFFE0FF);
+  assertRange(fx, 8, kLeds, 0x80C000);
+}
+
+void test_blend_alpha_mixes_by_opacity() {
+  LedEffects fx(kLeds, 0, NEO_GRB + NEO_KHZ800);
+  resetEngine(fx);
+  fillStatic(fx, 0, 0, kLeds, RED);
+  fx.setSegmentBlend(1, SEG_BLEND_ALPHA, 128);
+  fillStatic(fx, 1, 0, 8, BLUE);
+  assertRange(fx, 0, 8, 0x7E0080); // opacity 128 mixes 129/256 of the layer in
+  assertRange(fx, 8, kLeds, RED);
+
+  fx.setSegmentBlend(1, SEG_BLEND_ALPHA, 255);
+  fx.service();
+  assertRange(fx, 0, 8, BLUE);
+
+  fx.setSegmentBlend(1, SEG_BLEND_ALPHA, 0);
+  fx.service();
+  assertRange(fx, 0, 8, RED);
+}
+
+void test_clear_segment_uncovers_lower_layer() {
+  LedEffects fx(kLeds, 0, NEO_GRB + NEO_KHZ800);
+  resetEngine(fx);
+  fillStatic(fx, 0, 0, kLeds, RED);
+  fillStatic(fx, 1, 2, 6, GREEN);
+  fx.clearSegment(1);
+  fx.service();
+  TEST_ASSERT_FALSE(fx.isSegmentActive(1));
+  assertRange(fx, 0, kLeds, RED);
+}
+
+// An overlay fading in must not touch the lower layer outside its own range
+void test_overlay_fade_in_keeps_lower_layer_outside_range() {
+  LedEffects fx(kLeds, 0, NEO_GRB + NEO_KHZ800);
+  resetEngine(fx);
+  fillStatic(fx, 0, 0, kLeds, RED);
+  fx.setTransitionMs(1000);
+  fillStatic(fx, 1, 6, 12, BLUE);
+  for (unsigned long t = 0; t <= 1000; t += 250) {
+    native_shim::setMillis(t);
+    fx.service();
+    assertRange(fx, 0, 6, RED);
+    assertRange(fx, 12, kLeds, RED);
+  }
+  assertRange(fx, 6, 12, BLUE);
+}
+
+// Retargeting mid-fade freezes both ranges; the gap between them stays the lower layer's
+void test_retarget_mid_fade_keeps_gap_uncovered() {
+  LedEffects fx(kLeds, 0, NEO_GRB + NEO_KHZ800);
+  resetEngine(fx);
+  fillStatic(fx, 0, 0, kLeds, RED);
+  fillStatic(fx, 1, 0, 4, BLUE);
+  fx.setTransitionMs(1000);
+  fillStatic(fx, 1, 12, kLeds, GREEN);
+  native_shim::setMillis(500);
+  fillStatic(fx, 1, 12, kLeds, WHITE);
+  for (unsigned long t = 500; t <= 1500; t += 250) {
+    native_shim::setMillis(t);
+    fx.service();
+    assertRange(fx, 4, 12, RED);
+  }
+  assertRange(fx, 0, 4, RED);
+  assertRange(fx, 12, kLeds, WHITE);
+}
+
+// Team segments layout dims slice 0 by opacity; the next single effect must not stay dimmed
+void test_base_effect_restores_full_opacity() {
+  LedEffects fx(kLeds, 0, NEO_GRB + NEO_KHZ800);
+  resetEngine(fx);
+  fx.setSegmentBlend(0, SEG_BLEND_ALPHA, 64);
+  fillStatic(fx, 0, 0, 8, RED);
+  fillStatic(fx, 1, 8, kLeds, BLUE);
+  TEST_ASSERT_TRUE(fx.strip.getPixelColor(0) != RED);
+
+  fx.clearSegment(1);
+  fx.setBaseEffect(kLeds, FX_MODE_STATIC, RED, 3000, false);
+  fx.service();
+  assertRange(fx, 0, kLeds, RED);
+}
+
+void test_golden_frames_match_bench() {
+  std::map<std::string, uint32_t> golden;
+  TEST_ASSERT_TRUE_MESSAGE(loadGoldens(kDefaultGoldenPath, golden), "cannot read bench/golden_frames.txt");
+  std::map<std::string, uint32_t> actual;
+  replayAllGoldens(actual);
+  for (const auto& kv : actual) {
+    auto it = golden.find(kv.first);
+    TEST_ASSERT_TRUE_MESSAGE(it != golden.end(), ("no golden for " + kv.first).c_str());
+    TEST_ASSERT_EQUAL_HEX32_MESSAGE(it->second, kv.second, kv.first.c_str());
+  }
+  for (const auto& kv : golden) {
+    TEST_ASSERT_TRUE_MESSAGE(actual.count(kv.first) != 0, ("golden not replayed: " + kv.first).c_str());
+  }
+}
+
+int main(int, char**) {
+  UNITY_BEGIN();
+  RUN_TEST(test_scale_color_identity_at_full_brightness);
+  RUN_TEST(test_scale_color_follows_gamma_curve);
+  RUN_TEST(test_gamma_lut_is_monotonic_over_brightness);
+  RUN_TEST(test_zero_brightness_is_black);
+  RUN_TEST(test_segment_covers_only_its_range);
+  RUN_TEST(test_segment_end_is_clipped_to_strip);
+  RUN_TEST(test_segment_start_past_end_is_empty);
+  RUN_TEST(test_segment_index_out_of_range_is_ignored);
+  RUN_TEST(test_segments_clip_after_strip_shrinks);
+  RUN_TEST(test_blend_replace_overwrites_lower_layer);
+  RUN_TEST(test_blend_add_saturates);
+  RUN_TEST(test_blend_alpha_mixes_by_opacity);
+  RUN_TEST(test_clear_segment_uncovers_lower_layer);
+  RUN_TEST(test_overlay_fade_in_keeps_lower_layer_outside_range);
+  RUN_TEST(test_retarget_mid_fade_keeps_gap_uncovered);
+  RUN_TEST(test_base_effect_restores_full_opacity);
+  RUN_TEST(test_golden_frames_match_bench);
+  return UNITY_END();
+}